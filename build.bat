@@ -14,6 +14,7 @@ call "shell.bat"
 :: /Od         - Disables optimizations to improve debugging and speed up compilation.
 :: /O2         - Enables full optimization for speed, favoring performance over size.
 :: /c          - Compiles source files without linking, producing object files (.obj).
+:: /arch:AVX2  - Lets the compiler use AVX2 instructions and defines __AVX2__, which the software renderer's SIMD shading kernel checks.
 
 set B_UNICODE_FLAGS=/DUNICODE /D_UNICODE
 
@@ -21,7 +22,11 @@ set B_DEBUG_DEPENDANT_ARGS=/Zi /Od /D_DEBUG /MDd
 if /i "%1"=="release" set B_DEBUG_DEPENDANT_ARGS=/O2 /DNDEBUG /MD
 if /i "%1"=="profile" set B_DEBUG_DEPENDANT_ARGS=/O2 /DNDEBUG /MD /DENABLE_DETAILED_PERF_LOG
 
-set B_COMMON_FLAGS=/std:c++20 /EHsc %B_DEBUG_DEPENDANT_ARGS%
+:: Second argument avx2 targets CPUs with AVX2, others get SSE2 code, that any x64 CPU runs.
+set B_ARCH_ARGS=
+if /i "%2"=="avx2" set B_ARCH_ARGS=/arch:AVX2
+
+set B_COMMON_FLAGS=/std:c++20 /EHsc %B_DEBUG_DEPENDANT_ARGS% %B_ARCH_ARGS%
 set B_COMMON_INCLUDES=/I"..\src\renderer" /I"..\src\common" /I"..\extern\imgui" /I"..\extern\imgui\backends"
 
 set B_TESTS_INCLUDES=/I"%VCInstallDir%Auxiliary\VS\UnitTest\include"
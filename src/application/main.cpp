@@ -103,6 +103,9 @@ struct WindowContext
     Renderer::SceneRendererDX12 hardwareRenderer;
     Renderer::ImguiRenderer imguiRenderer;
     Renderer::Scene scene;
+    // Kept between frames per renderer, so the software renderer can leave an unchanged frame as is instead of shading it again.
+    Renderer::Texture softwareResult { RenderWidth, RenderHeight };
+    Renderer::Texture hardwareResult { RenderWidth, RenderHeight };
 
     Renderer::SceneRenderer* renderer = nullptr;
 };
@@ -128,7 +131,7 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
 
             HandleInput(windowContext->scene);
 
-            Renderer::Texture result(RenderWidth, RenderHeight);
+            Renderer::Texture& result = windowContext->renderer == &windowContext->softwareRenderer ? windowContext->softwareResult : windowContext->hardwareResult;
 
             Utils::FrameCounter::GetInstance().Start("Frame time");
             windowContext->renderer->Render(windowContext->scene, result);
@@ -161,9 +164,58 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
                 ImGui::Text("Current rasterizer: ");
                 ImGui::SameLine();
                 ImGui::Text(windowContext->renderer == &windowContext->hardwareRenderer ? "Hardware Rasterizer" : "Software Rasterizer");
+                ImGui::Text("Software raster kernel: ");
+                ImGui::SameLine();
+                ImGui::Text(windowContext->softwareRenderer.settings.rasterKernel == Renderer::SceneRendererSoftware::RasterKernel::Scanline ? "Scanline" : "Half-space");
+                ImGui::Text("Software shading kernel: ");
+                ImGui::SameLine();
+                ImGui::Text(windowContext->softwareRenderer.settings.shadingKernel == Renderer::SceneRendererSoftware::ShadingKernel::Scalar ? "Scalar" : "SIMD");
+                ImGui::Text("Software attributes: ");
+                ImGui::SameLine();
+                ImGui::Text(windowContext->softwareRenderer.settings.useVisibilityBuffer ? "Visibility buffer" : "G buffer");
+                ImGui::Text("Software single pass: ");
+                ImGui::SameLine();
+                ImGui::Text(windowContext->softwareRenderer.settings.useSinglePass ? "On" : "Off");
+                ImGui::Text("Software target frame time: %.0f ms, resolution scale: %.2f",
+                    windowContext->softwareRenderer.settings.targetFrameTime,
+                    windowContext->softwareRenderer.GetStatistics().resolutionScale
+                );
+                ImGui::Text("Software frame update: ");
+                ImGui::SameLine();
+                switch (windowContext->softwareRenderer.GetStatistics().frameUpdate)
+                {
+                    case Renderer::SceneRendererSoftware::FrameUpdate::Full: ImGui::Text("Full"); break;
+                    case Renderer::SceneRendererSoftware::FrameUpdate::Shading: ImGui::Text("Shading"); break;
+                    default: ImGui::Text("None"); break;
+                }
+                ImGui::Text("Hierarchical z rejected blocks: %llu of %llu",
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().hiZRejectedBlocks),
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().hiZTestedBlocks)
+                );
+                ImGui::Text("Frustum culled triangles: %llu",
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().culledTriangles)
+                );
+                ImGui::Text("Cone culled triangles: %llu",
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().coneCulledTriangles)
+                );
+                ImGui::Text("Occlusion culled triangles: %llu",
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().occludedTriangles)
+                );
+                ImGui::Text("Lights in tiles: %llu",
+                    static_cast<unsigned long long>(windowContext->softwareRenderer.GetStatistics().tileLights)
+                );
+                ImGui::Text("Overdraw: %.2f",
+                    static_cast<double>(windowContext->softwareRenderer.GetStatistics().depthWrittenPixels) /
+                    static_cast<double>(std::max<uint64_t>(windowContext->softwareRenderer.GetStatistics().coveredPixels, 1))
+                );
                 ImGui::Separator();
                 ImGui::Text("Help:");
                 ImGui::Text("Press R to switch renderer.");
+                ImGui::Text("Press K to switch software raster kernel.");
+                ImGui::Text("Press V to switch software visibility buffer.");
+                ImGui::Text("Press P to switch software single pass.");
+                ImGui::Text("Press T to switch software target frame time.");
+                ImGui::Text("Press L to switch software shading kernel.");
                 ImGui::Text("Use arrow keys to turn the camera.");
                 ImGui::Text("Use wasd keys to move the camera.");
                 ImGui::Separator();
@@ -212,6 +264,38 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
                         (Renderer::SceneRenderer*)&windowContext->hardwareRenderer;
                 }
 
+                if (ImGui::IsKeyPressed(ImGuiKey::ImGuiKey_K))
+                {
+                    Renderer::SceneRendererSoftware::RasterKernel& kernel = windowContext->softwareRenderer.settings.rasterKernel;
+                    kernel = kernel == Renderer::SceneRendererSoftware::RasterKernel::Scanline ?
+                        Renderer::SceneRendererSoftware::RasterKernel::HalfSpace :
+                        Renderer::SceneRendererSoftware::RasterKernel::Scanline;
+                }
+
+                if (ImGui::IsKeyPressed(ImGuiKey::ImGuiKey_L))
+                {
+                    Renderer::SceneRendererSoftware::ShadingKernel& kernel = windowContext->softwareRenderer.settings.shadingKernel;
+                    kernel = kernel == Renderer::SceneRendererSoftware::ShadingKernel::Scalar ?
+                        Renderer::SceneRendererSoftware::ShadingKernel::Simd :
+                        Renderer::SceneRendererSoftware::ShadingKernel::Scalar;
+                }
+
+                if (ImGui::IsKeyPressed(ImGuiKey::ImGuiKey_V))
+                {
+                    windowContext->softwareRenderer.settings.useVisibilityBuffer = !windowContext->softwareRenderer.settings.useVisibilityBuffer;
+                }
+
+                if (ImGui::IsKeyPressed(ImGuiKey::ImGuiKey_P))
+                {
+                    windowContext->softwareRenderer.settings.useSinglePass = !windowContext->softwareRenderer.settings.useSinglePass;
+                }
+
+                if (ImGui::IsKeyPressed(ImGuiKey::ImGuiKey_T))
+                {
+                    float& targetFrameTime = windowContext->softwareRenderer.settings.targetFrameTime;
+                    targetFrameTime = targetFrameTime > 0.0f ? 0.0f : 33.0f;
+                }
+
                 ImGui::End();
             });
 
@@ -7,6 +7,8 @@
 #include <string>
 #include <tuple>
 #include <map>
+#include <algorithm>
+#include <limits>
 #include <cassert>
 #include <iostream>
 
@@ -370,6 +372,17 @@ namespace Renderer
                 REPORT_ERROR();
             }
 
+            // radius is optional
+            if (std::getline(file, line) && !line.empty())
+            {
+                std::stringstream lineStream(line);
+
+                if (!(lineStream >> light.radius))
+                {
+                    REPORT_ERROR();
+                }
+            }
+
             REPORT_ERROR_IF_FALSE(file.is_open());
         }
 
@@ -396,6 +409,118 @@ namespace Renderer
 
             REPORT_ERROR_IF_FALSE(file.is_open());
         }
+
+        // Spreads bits of a 10 bit value, so that three of them interleave into a Morton code.
+        uint32_t SpreadBits(uint32_t value)
+        {
+            value = (value | (value << 16)) & 0x030000FF;
+            value = (value | (value << 8)) & 0x0300F00F;
+            value = (value | (value << 4)) & 0x030C30C3;
+            value = (value | (value << 2)) & 0x09249249;
+            return value;
+        }
+
+        // Octahedral mapping of the direction onto a square, split into DirectionCells x DirectionCells cells.
+        uint32_t GetDirectionCell(const Vec& direction)
+        {
+            constexpr uint32_t DirectionCells = 8;
+
+            float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+            if (length == 0.0f)
+            {
+                return 0;
+            }
+
+            float u = direction.x / length;
+            float v = direction.y / length;
+            if (direction.z < 0.0f)
+            {
+                float foldedU = (1.0f - fabsf(v)) * (u < 0.0f ? -1.0f : 1.0f);
+                float foldedV = (1.0f - fabsf(u)) * (v < 0.0f ? -1.0f : 1.0f);
+                u = foldedU;
+                v = foldedV;
+            }
+
+            auto cell = [](float value) { return std::min(static_cast<uint32_t>((value + 1.0f) * 0.5f * DirectionCells), DirectionCells - 1); };
+            return cell(v) * DirectionCells + cell(u);
+        }
+
+        // Triangles in files are ordered by parts of the model, which face all directions, so consecutive triangles make poor clusters.
+        // Triangles are grouped by the direction cell of their normal and ordered along a Morton curve inside of a group, so consecutive
+        // triangles are close to each other and face roughly the same way. Vertices are then stored in the order triangles use them first.
+        // Returns direction cells of the sorted triangles. Models, that fit in one cluster, are kept as they are.
+        std::vector<uint32_t> SortTrianglesForClusters(Model& model)
+        {
+            uint32_t trianglesCount = static_cast<uint32_t>(model.indices.size() / 3);
+            if (trianglesCount <= TrianglesPerCluster)
+            {
+                return std::vector<uint32_t>(trianglesCount, 0);
+            }
+
+            Vec min = model.vertices[0].position;
+            Vec max = model.vertices[0].position;
+            for (const Vertex& vertex : model.vertices)
+            {
+                min = { std::min(min.x, vertex.position.x), std::min(min.y, vertex.position.y), std::min(min.z, vertex.position.z), 0.0f };
+                max = { std::max(max.x, vertex.position.x), std::max(max.y, vertex.position.y), std::max(max.z, vertex.position.z), 0.0f };
+            }
+
+            auto quantize = [](float value, float min, float max) {
+                return max > min ? static_cast<uint32_t>((value - min) / (max - min) * 1023.0f) : 0;
+            };
+
+            std::vector<std::pair<uint64_t, uint32_t>> keys(trianglesCount);
+            for (uint32_t triangle = 0; triangle < trianglesCount; triangle++)
+            {
+                const Vec& p0 = model.vertices[model.indices[triangle * 3 + 0]].position;
+                const Vec& p1 = model.vertices[model.indices[triangle * 3 + 1]].position;
+                const Vec& p2 = model.vertices[model.indices[triangle * 3 + 2]].position;
+
+                Vec normal = cross(p1 - p0, p2 - p0);
+                uint64_t direction = GetDirectionCell(normal);
+
+                Vec centroid = (p0 + p1 + p2) * (1.0f / 3.0f);
+                uint32_t morton = SpreadBits(quantize(centroid.x, min.x, max.x)) |
+                    (SpreadBits(quantize(centroid.y, min.y, max.y)) << 1) |
+                    (SpreadBits(quantize(centroid.z, min.z, max.z)) << 2);
+
+                keys[triangle] = { (direction << 32) | morton, triangle };
+            }
+
+            std::stable_sort(keys.begin(), keys.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+            std::vector<uint32_t> directions(trianglesCount);
+            std::vector<uint32_t> indices(model.indices.size());
+            for (uint32_t i = 0; i < trianglesCount; i++)
+            {
+                directions[i] = static_cast<uint32_t>(keys[i].first >> 32);
+
+                for (uint32_t j = 0; j < 3; j++)
+                {
+                    indices[i * 3 + j] = model.indices[keys[i].second * 3 + j];
+                }
+            }
+
+            constexpr uint32_t NotUsed = std::numeric_limits<uint32_t>::max();
+            std::vector<uint32_t> newVertexIndices(model.vertices.size(), NotUsed);
+            std::vector<Vertex> vertices;
+            vertices.reserve(model.vertices.size());
+            for (uint32_t& index : indices)
+            {
+                if (newVertexIndices[index] == NotUsed)
+                {
+                    newVertexIndices[index] = static_cast<uint32_t>(vertices.size());
+                    vertices.push_back(model.vertices[index]);
+                }
+
+                index = newVertexIndices[index];
+            }
+
+            model.indices = std::move(indices);
+            model.vertices = std::move(vertices);
+
+            return directions;
+        }
     }
 
     bool operator<(const Vertex& lhs, const Vertex& rhs)
@@ -436,6 +561,8 @@ namespace Renderer
                     {
                         if (Load(ReplaceFileNameInFullPath(fullFileName, fileName), model))
                         {
+                            SetupClusters(model);
+
                             std::string culling;
                             if (lineStream >> culling)
                             {
@@ -470,9 +597,14 @@ namespace Renderer
                 }
                 else if (extension == EXTENSION_LIGHT)
                 {
-                    if (Read(lineStream, 3, 1.0f, scene.light.position))
+                    Light light;
+                    if (Read(lineStream, 3, 1.0f, light.position))
                     {
-                        if (!Load(ReplaceFileNameInFullPath(fullFileName, fileName), scene.light))
+                        if (Load(ReplaceFileNameInFullPath(fullFileName, fileName), light))
+                        {
+                            scene.lights.push_back(light);
+                        }
+                        else
                         {
                             REPORT_ERROR();
                         }
@@ -494,6 +626,116 @@ namespace Renderer
         REPORT_ERROR_IF_FALSE(file.is_open());
     }
 
+    void SetupClusters(Model& model)
+    {
+        auto extend = [](Bounds& bounds, const Vec& position) {
+            bounds.min = { std::min(bounds.min.x, position.x), std::min(bounds.min.y, position.y), std::min(bounds.min.z, position.z), 1.0f };
+            bounds.max = { std::max(bounds.max.x, position.x), std::max(bounds.max.y, position.y), std::max(bounds.max.z, position.z), 1.0f };
+        };
+
+        model.clusters.clear();
+
+        std::vector<uint32_t> directions = SortTrianglesForClusters(model);
+
+        // Cluster takes up to TrianglesPerCluster triangles of the same direction cell.
+        uint32_t trianglesCount = static_cast<uint32_t>(model.indices.size() / 3);
+        for (uint32_t firstTriangle = 0; firstTriangle < trianglesCount; firstTriangle += model.clusters.back().trianglesCount)
+        {
+            Cluster& cluster = model.clusters.emplace_back();
+            cluster.firstTriangle = firstTriangle;
+            cluster.trianglesCount = 1;
+            while (cluster.trianglesCount < std::min(TrianglesPerCluster, trianglesCount - firstTriangle) &&
+                directions[firstTriangle + cluster.trianglesCount] == directions[firstTriangle])
+            {
+                cluster.trianglesCount++;
+            }
+
+            const Vec& firstPosition = model.vertices[model.indices[firstTriangle * 3]].position;
+            cluster.bounds = { firstPosition, firstPosition };
+
+            uint32_t minIndex = model.indices[firstTriangle * 3];
+            uint32_t maxIndex = minIndex;
+            for (uint32_t i = firstTriangle * 3; i < (firstTriangle + cluster.trianglesCount) * 3; i++)
+            {
+                minIndex = std::min(minIndex, model.indices[i]);
+                maxIndex = std::max(maxIndex, model.indices[i]);
+                extend(cluster.bounds, model.vertices[model.indices[i]].position);
+            }
+
+            cluster.firstVertex = minIndex;
+            cluster.verticesCount = maxIndex - minIndex + 1;
+
+            auto getNormal = [&model](uint32_t triangle, Vec& normal) {
+                const Vec& p0 = model.vertices[model.indices[triangle * 3 + 0]].position;
+                const Vec& p1 = model.vertices[model.indices[triangle * 3 + 1]].position;
+                const Vec& p2 = model.vertices[model.indices[triangle * 3 + 2]].position;
+
+                normal = cross(p1 - p0, p2 - p0);
+                float length = sqrtf(dot(normal, normal));
+                if (length == 0.0f)
+                {
+                    return false;
+                }
+
+                normal = normal * (1.0f / length);
+                return true;
+            };
+
+            // Degenerate triangles cover no pixels, so they do not limit the cone.
+            Vec normalsSum;
+            for (uint32_t triangle = firstTriangle; triangle < firstTriangle + cluster.trianglesCount; triangle++)
+            {
+                Vec normal;
+                if (getNormal(triangle, normal))
+                {
+                    normalsSum = normalsSum + normal;
+                }
+            }
+
+            if (dot(normalsSum, normalsSum) > 0.0f)
+            {
+                cluster.coneAxis = normalize(normalsSum);
+
+                float minDot = 1.0f;
+                for (uint32_t triangle = firstTriangle; triangle < firstTriangle + cluster.trianglesCount; triangle++)
+                {
+                    Vec normal;
+                    if (getNormal(triangle, normal))
+                    {
+                        minDot = std::min(minDot, dot(normal, cluster.coneAxis));
+                    }
+                }
+
+                if (minDot > 0.0f)
+                {
+                    cluster.coneCutoff = sqrtf(1.0f - minDot * minDot);
+
+                    // Apex is moved back from the center along the axis until it is behind the planes of all the triangles.
+                    Vec center = (cluster.bounds.min + cluster.bounds.max) * 0.5f;
+                    float maxDistance = 0.0f;
+                    for (uint32_t triangle = firstTriangle; triangle < firstTriangle + cluster.trianglesCount; triangle++)
+                    {
+                        Vec normal;
+                        if (getNormal(triangle, normal))
+                        {
+                            const Vec& p0 = model.vertices[model.indices[triangle * 3]].position;
+                            maxDistance = std::max(maxDistance, dot(center - p0, normal) / dot(cluster.coneAxis, normal));
+                        }
+                    }
+
+                    cluster.coneApex = center - cluster.coneAxis * maxDistance;
+                }
+            }
+        }
+
+        model.bounds = model.clusters.empty() ? Bounds{} : model.clusters[0].bounds;
+        for (const Cluster& cluster : model.clusters)
+        {
+            extend(model.bounds, cluster.bounds.min);
+            extend(model.bounds, cluster.bounds.max);
+        }
+    }
+
     Matrix PerspectiveTransform(const Camera& camera, float width, float height)
     {
         float halfFieldOfView = camera.fieldOfView * (static_cast<float>(M_PI) / 180);
@@ -25,6 +25,32 @@ namespace Renderer
         std::string textureName;
     };
 
+    // Axis aligned box in model space.
+    struct Bounds
+    {
+        Vec min;
+        Vec max;
+    };
+
+    // Consecutive triangles of a model (meshlet), that renderers can reject as a whole.
+    struct Cluster
+    {
+        uint32_t firstTriangle = 0;
+        uint32_t trianglesCount = 0;
+        // Range of vertices referenced by the triangles. Vertices are stored in the order triangles use them first, so ranges of clusters barely overlap.
+        uint32_t firstVertex = 0;
+        uint32_t verticesCount = 0;
+        Bounds bounds;
+
+        // Cone around the front facing normals of the triangles (counter clockwise is front). Apex is behind the planes of all the triangles.
+        // Cutoff is the sine of the cone's half angle, it is 1 if the normals spread too wide for the cone to tell anything.
+        Vec coneApex;
+        Vec coneAxis;
+        float coneCutoff = 1.0f;
+    };
+
+    constexpr uint32_t TrianglesPerCluster = 128;
+
     struct Model
     {
         Vec position;
@@ -32,6 +58,20 @@ namespace Renderer
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
         bool backfaceCulling = true;
+
+        // Calculated from vertices and indices while loading.
+        Bounds bounds;
+        std::vector<Cluster> clusters;
+        // Renderers keep what they build from the geometry between frames and tell edits only by replaced buffers or by the version.
+        // Callers have to increment it after editing vertices or indices in place. Bounds and clusters are rebuilt only by SetupClusters.
+        uint32_t version = 0;
+    };
+
+    // Places a model of the scene with its own transform. Instances share the vertices, indices and materials of the model.
+    struct Instance
+    {
+        uint32_t model = 0; // Index in the scene models.
+        Matrix transform; // Model to world space, without non-uniform scale.
     };
 
     struct Light
@@ -42,6 +82,9 @@ namespace Renderer
         float specularStrength = 0.0f;
         float specularShininess = 0.0f;
         Color color = Color::White;
+
+        // Light fades out towards the radius and does not reach beyond it. Zero radius reaches everything without fading.
+        float radius = 0.0f;
     };
 
     struct Camera
@@ -67,13 +110,19 @@ namespace Renderer
     {
         std::string name;
         DebugContext debugContext;
-        Light light;
+        // Hardware renderer lights the scene only by the first one.
+        std::vector<Light> lights;
         Camera camera;
         std::vector<Model> models;
+        // Drawn by the software renderer instead of the models at their positions, if not empty.
+        std::vector<Instance> instances;
     };
 
     bool Load(const std::string& fullFileName, Scene& scene);
 
+    // Reorders triangles and vertices of the model into clusters and calculates their bounds. Should be called again, if vertices or indices of a loaded model are changed.
+    void SetupClusters(Model& model);
+
     // In view space we are at 0 looking down the negative z axis.
     // Near plane of the camera frustum is at -Near, far plane of the camera frustum is at -Far.
     // As DirectX clip space z axis ranges from 0 to 1, we map -Near to 0 and -Far to 1.
@@ -530,7 +530,7 @@ namespace Renderer
             };
 
             // calculate light's position in view space
-            Vec position_view = ViewTransform(scene.camera) * scene.light.position;
+            Vec position_view = scene.lights.empty() ? Vec{} : ViewTransform(scene.camera) * scene.lights[0].position;
             DirectX::XMVECTOR lightPos = { position_view.x, position_view.y, position_view.z, position_view.w };
 
             SetConstants(mvpX, mvX, lightPos);
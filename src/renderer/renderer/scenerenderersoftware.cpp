@@ -9,12 +9,48 @@
 #include <execution>
 #include <ranges>
 #include <utility>
+#include <limits>
+#include <tuple>
+#include <bit>
+#include <chrono>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "utils.h"
 
 namespace Renderer
 {
-    static constexpr uint32_t InterpolantsSize = 13;
+    // Interpolants of the widest attribute layout, padded to whole SIMD vectors, and z, which is always the last one.
+    static constexpr uint32_t InterpolantsSize = 9;
+    static constexpr uint32_t ZInterpolant = InterpolantsSize - 1;
+
+    // Interpolants, that triangles carry besides z, and their order. Textured models take color from textures and the others
+    // from vertex colors, so each needs only one of them. View position is not interpolated, it is reconstructed from depth.
+    // Raster and shading kernels are instantiated per layout and touch only its interpolants.
+    template<bool IsTextured>
+    struct AttributeLayout
+    {
+        static constexpr bool HasTint = !IsTextured;
+        static constexpr bool HasTextureCoord = IsTextured;
+
+        static constexpr uint32_t Tint = 0;
+        static constexpr uint32_t TextureCoord = 0;
+        static constexpr uint32_t Normal = HasTint ? 3 : 2;
+        static constexpr uint32_t W = Normal + 3; // Interpolated 1 / w, attributes are divided by it.
+        static constexpr uint32_t Count = W + 1;
+        // Loops over interpolants run over whole SIMD vectors of 4, interpolants past Count are zero.
+        static constexpr uint32_t PaddedCount = (Count + 3) / 4 * 4;
+
+        static_assert(PaddedCount <= ZInterpolant);
+    };
+
+    using ColoredLayout = AttributeLayout<false>;
+    using TexturedLayout = AttributeLayout<true>;
+
+    // Depth buffer is cleared to a value farther than any depth after clipping, so pixels still holding it are not covered.
+    static constexpr float ClearDepth = 2.0f;
 
     struct InterpolationPoint
     {
@@ -45,7 +81,7 @@ namespace Renderer
         float minC = 0.0f;
         float midC = 0.0f;
 
-        float CalculateC(float dx, float dy, bool isMin)
+        float CalculateC(float dx, float dy, bool isMin) const
         {
             return (isMin ? minC : midC) + dy * stepY + dx * stepX;
         }
@@ -60,7 +96,6 @@ namespace Renderer
     struct VertexS
     {
         Vertex v;
-        Vec pos_view;
 
         // todo.pavelza: need to get rid of these, just needed for easier interpolation
         float red = 0.0f;
@@ -68,13 +103,77 @@ namespace Renderer
         float blue = 0.0f;
     };
 
+    // Model vertices after the vertex stage, one array per attribute. Every vertex is transformed once per frame and triangles
+    // reference them by index, so vertices shared by several triangles are not transformed again.
+    struct TransformedVertices
+    {
+        std::vector<Vec> positions; // Clip space.
+        std::vector<Vec> normals; // View space.
+
+        // Bit per frustum plane, set if the vertex is outside of it.
+        std::vector<uint8_t> outsidePlanes;
+        // Same for x and y planes moved out by the guard band.
+        std::vector<uint8_t> outsideGuardBand;
+    };
+
+    // Model of the frame, its vertices and textures are stored after the ones of the previous models.
+    // Prepared once per model of the scene and shared by all of its instances.
+    struct ModelResources
+    {
+        uint32_t firstTexture = 0;
+        uint32_t firstColor = 0;
+    };
+
+    // Instance of a model drawn in the frame.
+    struct ModelBatch
+    {
+        const Model* model = nullptr;
+        const ModelResources* resources = nullptr;
+        Matrix transform; // Model to view space.
+        Matrix clipTransform; // Model to clip space.
+        uint32_t firstVertex = 0;
+    };
+
+    // Range of a model's vertices or triangles processed by a single task. Geometry of all models is split into chunks,
+    // that go through the same vertex, setup and binning stages, so many small models do not restart the pipeline each.
+    struct GeometryChunk
+    {
+        uint32_t batch = 0;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    // Triangle clipped by the 6 frustum planes gets at most one extra vertex per plane.
+    static constexpr uint32_t MaxPolygonVertices = 9;
+
+    // Clipping works on polygons stored inline, so it does not allocate.
+    struct Polygon
+    {
+        std::array<VertexS, MaxPolygonVertices> vertices;
+        uint32_t size = 0;
+
+        void Add(const VertexS& vertex)
+        {
+            assert(size < MaxPolygonVertices);
+            vertices[size++] = vertex;
+        }
+    };
+
+    struct EdgeSample
+    {
+        int32_t pixelX = 0;
+
+        // todo.pavelza: C along the edge. Need to rename the C into interpolated value or something like this.
+        std::array<float, InterpolantsSize> currentC;
+    };
+
     struct Edge
     {
         Edge()
         {
         }
 
-        Edge(Vec b, Vec e, bool isMin = true) : begin(b), isBeginMin(isMin), pixelX(0)
+        Edge(Vec b, Vec e, bool isMin = true) : begin(b), isBeginMin(isMin)
         {
             pixelYBegin = static_cast<int32_t>(ceil(b.y));
             pixelYEnd = static_cast<int32_t>(ceil(e.y));
@@ -84,528 +183,3210 @@ namespace Renderer
             stepX = distanceY > 0.0f ? distanceX / distanceY : 0.0f;
         }
 
-        void CalculateC(std::array<Interpolant, InterpolantsSize>& interpolants, int32_t y)
+        // Edges are shared between tiles that are rasterized in parallel, so sampling an edge must not modify it.
+        template<typename Layout>
+        void CalculateC(const std::array<Interpolant, InterpolantsSize>& interpolants, int32_t y, EdgeSample& sample) const
         {
-            pixelX = static_cast<int32_t>(ceil(begin.x + (y - begin.y) * stepX));
-            for (size_t i = 0; i < InterpolantsSize; i++)
+            sample.pixelX = static_cast<int32_t>(ceil(begin.x + (y - begin.y) * stepX));
+            for (size_t i = 0; i < Layout::PaddedCount; i++)
             {
-                currentC[i] = interpolants[i].CalculateC(pixelX - begin.x, y - begin.y, isBeginMin);
+                sample.currentC[i] = interpolants[i].CalculateC(sample.pixelX - begin.x, y - begin.y, isBeginMin);
             }
+            sample.currentC[ZInterpolant] = interpolants[ZInterpolant].CalculateC(sample.pixelX - begin.x, y - begin.y, isBeginMin);
         }
 
-        void CalculateCForZOnly(std::array<Interpolant, InterpolantsSize>& interpolants, int32_t y)
+        void CalculateCForZOnly(const std::array<Interpolant, InterpolantsSize>& interpolants, int32_t y, EdgeSample& sample) const
         {
-            pixelX = static_cast<int32_t>(ceil(begin.x + (y - begin.y) * stepX));
-            currentC[12] = interpolants[12].CalculateC(pixelX - begin.x, y - begin.y, isBeginMin);
+            sample.pixelX = static_cast<int32_t>(ceil(begin.x + (y - begin.y) * stepX));
+            sample.currentC[ZInterpolant] = interpolants[ZInterpolant].CalculateC(sample.pixelX - begin.x, y - begin.y, isBeginMin);
         }
 
         int32_t pixelYBegin;
         int32_t pixelYEnd;
-        int32_t pixelX;
 
         float stepX;
         bool isBeginMin;
         Vec begin;
-
-        // todo.pavelza: C along the edge. Need to rename the C into interpolated value or something like this.
-        std::array<float, InterpolantsSize> currentC;
     };
 
-    struct Triangle
+    // Linear function of the screen position. It is evaluated relative to the origin, so the precision does not depend on where on the screen the triangle is.
+    struct Plane
     {
-        uint32_t texture = 0;
-
-        std::array<Interpolant, InterpolantsSize> interpolants;
-        std::vector<VertexS> vertices;
+        float originX = 0.0f;
+        float originY = 0.0f;
+        float stepX = 0.0f;
+        float stepY = 0.0f;
+        float c = 0.0f;
 
-        Edge minMax;
-        Edge minMiddle;
-        Edge middleMax;
+        float At(float x, float y) const
+        {
+            return c + (x - originX) * stepX + (y - originY) * stepY;
+        }
     };
 
-    struct SceneRendererSoftwareContext
-    {
-        SceneRendererSoftwareContext(const Scene& scene): scene(scene) {}
-
-        const Scene& scene;
-
-        size_t OutputWidth;
-        size_t OutputHeight;
-
-        std::vector<uint32_t> BackBuffer;
-        std::vector<float> ZBuffer;
-        std::vector<Texture> Textures;
-        LightS light;
+    // Vertices are snapped to 16.8 fixed point, so edge functions are exact integers and stepping them is just an addition.
+    static constexpr int32_t SubpixelBits = 8;
+    static constexpr int64_t SubpixelScale = 1 << SubpixelBits;
 
-        std::vector<std::array<float, InterpolantsSize>> GBuffer;
-        std::vector<uint32_t> TBuffer;
+    // Edge function of the pixel position, positive inside of the triangle. Fill rule bias is already included in c,
+    // so a pixel is covered when it is not negative. Products of 16.8 coordinates do not fit 32 bits, hence 64 bit values.
+    struct EdgeFunction
+    {
+        int64_t c = 0;
+        int64_t stepX = 0;
+        int64_t stepY = 0;
 
-        float Lerp(float begin, float end, float lerpAmount)
+        int64_t At(int32_t x, int32_t y) const
         {
-            return begin + (end - begin) * lerpAmount;
+            return c + stepX * x + stepY * y;
         }
+    };
 
-        void FillZBuffer(Triangle& tr)
-        {
-            for (int32_t y = tr.minMax.pixelYBegin; y < tr.minMax.pixelYEnd; y++)
-            {
-                Edge* left = &tr.minMax;
-                Edge* right = y >= tr.middleMax.pixelYBegin ? &tr.middleMax : &tr.minMiddle;
+    // Triangle description for the half-space kernel. Pixel is covered if all edge functions are not negative.
+    struct HalfSpaceSetup
+    {
+        std::array<EdgeFunction, 3> edges;
 
-                left->CalculateCForZOnly(tr.interpolants, y);
-                right->CalculateCForZOnly(tr.interpolants, y);
+        Plane z;
 
-                if (left->pixelX > right->pixelX)
-                {
-                    Edge* temp = left;
-                    left = right;
-                    right = temp;
-                }
+        // Interpolants except z, relative to the first vertex, laid out to evaluate all of them at once with SIMD.
+        float originX = 0.0f;
+        float originY = 0.0f;
+        alignas(16) std::array<float, InterpolantsSize - 1> c;
+        alignas(16) std::array<float, InterpolantsSize - 1> stepX;
+        alignas(16) std::array<float, InterpolantsSize - 1> stepY;
+    };
 
-                for (int32_t x = left->pixelX; x < right->pixelX; x++)
-                {
-                    float percent = static_cast<float>(x - left->pixelX) / static_cast<float>(right->pixelX - left->pixelX);
-                    float z = Lerp(left->currentC[12], right->currentC[12], percent);
-                    if (z < ZBuffer[y * OutputWidth + x])
-                    {
-                        ZBuffer[y * OutputWidth + x] = z;
-                    }
-                }
-            }
-        }
+    // Triangles without texture take color from their vertices.
+    static constexpr uint32_t NoTexture = std::numeric_limits<uint32_t>::max();
 
-        void FillGBuffer(Triangle& tr)
+    struct Triangle
+    {
+        // Index among the textures of all models. Whether the triangle is textured also selects its attribute layout.
+        uint32_t texture = NoTexture;
+
+        bool IsTextured() const
         {
-            for (int32_t y = tr.minMax.pixelYBegin; y < tr.minMax.pixelYEnd; y++)
-            {
-                Edge* left = &tr.minMax;
-                Edge* right = y >= tr.middleMax.pixelYBegin ? &tr.middleMax : &tr.minMiddle;
+            return texture != NoTexture;
+        }
 
-                left->CalculateC(tr.interpolants, y);
-                right->CalculateC(tr.interpolants, y);
+        std::array<Interpolant, InterpolantsSize> interpolants;
+        std::array<VertexS, 3> vertices;
 
-                if (left->pixelX > right->pixelX)
-                {
-                    Edge* temp = left;
-                    left = right;
-                    right = temp;
-                }
+        Edge minMax;
+        Edge minMiddle;
+        Edge middleMax;
 
-                for (int32_t x = left->pixelX; x < right->pixelX; x++)
-                {
-                    float percent = static_cast<float>(x - left->pixelX) / static_cast<float>(right->pixelX - left->pixelX);
-                    float z = Lerp(left->currentC[12], right->currentC[12], percent);
-                    if (z == ZBuffer[y * OutputWidth + x])
-                    {
-                        for (uint32_t i = 0; i < InterpolantsSize - 1; i++)
-                        {
-                            if (GBuffer[y * OutputWidth + x][i] != 0.0f)
-                            {
-                                // todo.pavelza: this might trigger if there is same z for two triangles, should we do something about it?
-                                // assert(false);
-                            }
-                            GBuffer[y * OutputWidth + x][i] = Lerp(left->currentC[i], right->currentC[i], percent);
-                        }
-                        TBuffer[y * OutputWidth + x] = tr.texture;
-                        GBuffer[y * OutputWidth + x][12] = z;
-                    }
-                }
-            }
-        }
+        // Filled only when half-space kernel is used.
+        HalfSpaceSetup halfSpace;
 
-        void ShadePixels()
-        {
-            auto r = std::ranges::iota_view<int32_t, int32_t>{ 0, static_cast<int32_t>(OutputWidth * OutputHeight) };
-            std::for_each(std::execution::par, r.begin(), r.end(), [this](int32_t i) {
-                std::array<float, InterpolantsSize>& interpolants_raw = GBuffer[i];
+        // Conservative screen space bounds in pixels, end is exclusive. Used for binning triangles into tiles.
+        int32_t boundsBeginX = 0;
+        int32_t boundsEndX = 0;
+        int32_t boundsBeginY = 0;
+        int32_t boundsEndY = 0;
 
-                if (interpolants_raw[12] != 0.0f)
-                {
-                    float tintRed = interpolants_raw[0] / interpolants_raw[11];
-                    float tintGreen = interpolants_raw[1] / interpolants_raw[11];
-                    float tintBlue = interpolants_raw[2] / interpolants_raw[11];
+        // Depth range of the triangle, used to test it against hierarchical z.
+        float minZ = 0.0f;
+        float maxZ = 0.0f;
 
-                    float texX = interpolants_raw[3] / interpolants_raw[11];
-                    float texY = interpolants_raw[4] / interpolants_raw[11];
+        // Index in the list of binned triangles, written to the visibility buffer.
+        uint32_t id = 0;
+    };
 
-                    float normalX = interpolants_raw[5] / interpolants_raw[11];
-                    float normalY = interpolants_raw[6] / interpolants_raw[11];
-                    float normalZ = interpolants_raw[7] / interpolants_raw[11];
+    enum class RasterPass
+    {
+        Depth, // Keeps the closest z.
+        Visibility, // Keeps the closest z and the triangle it belongs to.
+        DepthAttributes, // Keeps the closest z and writes interpolants of every pixel, that passes the depth test.
+        Attributes // Writes interpolants where z is equal to the one left by the depth pass.
+    };
 
-                    float viewX = interpolants_raw[8] / interpolants_raw[11];
-                    float viewY = interpolants_raw[9] / interpolants_raw[11];
-                    float viewZ = interpolants_raw[10] / interpolants_raw[11];
+    // Packed G buffer layouts keep attributes already divided by w and quantized, so shading reads a fraction of the memory.
+    using GBufferLayout = SceneRendererSoftware::GBufferLayout;
 
-                    Vec pos_view{ viewX, viewY, viewZ, 1.0f };
-                    Vec normal_vec = normalize({ normalX, normalY, normalZ, 0.0f });
-                    Vec light_vec = normalize(light.position_view - pos_view);
+    // Attributes of the surface visible in a pixel, divided by w.
+    struct SurfaceAttributes
+    {
+        Vec tint;
+        float texX = 0.0f;
+        float texY = 0.0f;
+        Vec normal; // Not normalized.
+        Vec viewPosition;
+    };
 
-                    Vec diffuse = light.light.color.GetVec() * static_cast<float>(std::max<float>(dot(normal_vec, light_vec), 0.0f));
-                    Vec ambient = light.light.color.GetVec() * light.light.ambientStrength;
+    // Surface of a textured layout is left white, as its color comes from the texture. Coverage and view position are left to the caller.
+    template<typename Layout>
+    static void UnpackInterpolants(const std::array<float, InterpolantsSize>& interpolants, SurfaceAttributes& surface)
+    {
+        float w = interpolants[Layout::W];
+        surface.tint = { 1.0f, 1.0f, 1.0f, 1.0f };
+        if constexpr (Layout::HasTint)
+        {
+            surface.tint = { interpolants[Layout::Tint] / w, interpolants[Layout::Tint + 1] / w, interpolants[Layout::Tint + 2] / w, 1.0f };
+        }
 
-                    float specAmount = static_cast<float>(std::max<float>(dot(normalize(pos_view), reflect(normal_vec, light_vec * -1.0f)), 0.0f));
-                    Vec specular = light.light.color.GetVec() * pow(specAmount, light.light.specularShininess) * light.light.specularStrength;
+        if constexpr (Layout::HasTextureCoord)
+        {
+            surface.texX = interpolants[Layout::TextureCoord] / w;
+            surface.texY = interpolants[Layout::TextureCoord + 1] / w;
+        }
 
-                    Vec final_color{ tintRed, tintGreen, tintBlue, 1.0f };
-                    if (Textures.size() > 0)
-                    {
-                        uint32_t materialId = TBuffer[i];
-                        assert(Textures[materialId].GetHeight() > 0 && Textures[materialId].GetWidth() > 0);
+        surface.normal = { interpolants[Layout::Normal] / w, interpolants[Layout::Normal + 1] / w, interpolants[Layout::Normal + 2] / w, 0.0f };
+    }
 
-                        // From 0 to TextureWidth - 1 (TextureWidth pixels in total)
-                        size_t textureX = static_cast<size_t>(texX * (Textures[materialId].GetWidth() - 1));
-                        // From 0 to TextureHeight - 1 (TextureHeight pixels in total)
-                        size_t textureY = static_cast<size_t>(texY * (Textures[materialId].GetHeight() - 1));
+    // Pixels take interpolants of the attribute layout except z, not divided by w yet, and return false from Read, if no triangle covers them.
+    // G buffer is not cleared, pixels are written only where triangles cover the depth buffer, so coverage is told by the depth.
+    // Only the packed layout keeps view position, the others leave it to the caller.
+    template<GBufferLayout PixelLayout>
+    struct GBufferPixel
+    {
+        std::array<float, InterpolantsSize> interpolants;
 
-                        textureY = (Textures[materialId].GetHeight() - 1) - textureY; // invert texture coords
+        template<typename Layout>
+        void Write(const float* values, float z, const Vec&)
+        {
+            std::copy(values, values + Layout::Count, interpolants.begin());
+            interpolants[ZInterpolant] = z;
+        }
 
-                        assert(textureY < Textures[materialId].GetHeight() && textureX < Textures[materialId].GetWidth());
-                        size_t texelBase = textureY * Textures[materialId].GetWidth() + textureX;
+        template<typename Layout>
+        bool Read(float z, SurfaceAttributes& surface) const
+        {
+            if (z == ClearDepth)
+            {
+                return false;
+            }
 
-                        final_color = Textures[materialId].GetColor(texelBase).GetVec();
-                    }
+            UnpackInterpolants<Layout>(interpolants, surface);
+            return true;
+        }
+    };
 
-                    final_color = (diffuse + ambient + specular) * final_color;
-                    final_color.x = std::clamp(final_color.x, 0.0f, 1.0f);
-                    final_color.y = std::clamp(final_color.y, 0.0f, 1.0f);
-                    final_color.z = std::clamp(final_color.z, 0.0f, 1.0f);
-                    final_color.w = 1.0f; // fix the alpha being affected by light, noticable only in tests, because in application we correct alpha manually when copying to backbuffer
+    struct PackedGBufferPixel
+    {
+        uint32_t normal;
+        uint32_t textureCoord;
+        uint32_t tint;
 
-                    assert(OutputWidth > 0);
-                    assert(OutputHeight > 0);
-                    size_t coefficient1 = OutputWidth * OutputHeight - OutputWidth;
-                    size_t coefficient2 = 2 * OutputWidth;
-                    BackBuffer[coefficient1 - (i / OutputWidth) * coefficient2 + i] = Color(final_color).rgba;
-                }
-            });
+        // Packing runs for every pixel written by the attribute pass, so rounding is done by truncation of the value moved by a half.
+        static uint32_t PackUnorm16(float value)
+        {
+            return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
         }
 
-        VertexS Lerp(const VertexS& begin, const VertexS& end, float lerpAmount)
+        static float UnpackUnorm16(uint32_t bits)
         {
-            VertexS result;
-            result.v.position.x = Lerp(begin.v.position.x, end.v.position.x, lerpAmount);
-            result.v.position.y = Lerp(begin.v.position.y, end.v.position.y, lerpAmount);
-            result.v.position.z = Lerp(begin.v.position.z, end.v.position.z, lerpAmount);
-            result.v.position.w = Lerp(begin.v.position.w, end.v.position.w, lerpAmount);
-            result.pos_view.x = Lerp(begin.pos_view.x, end.pos_view.x, lerpAmount);
-            result.pos_view.y = Lerp(begin.pos_view.y, end.pos_view.y, lerpAmount);
-            result.pos_view.z = Lerp(begin.pos_view.z, end.pos_view.z, lerpAmount);
-            result.pos_view.w = Lerp(begin.pos_view.w, end.pos_view.w, lerpAmount);
-            result.v.textureCoord.x = Lerp(begin.v.textureCoord.x, end.v.textureCoord.x, lerpAmount);
-            result.v.textureCoord.y = Lerp(begin.v.textureCoord.y, end.v.textureCoord.y, lerpAmount);
-            result.red = Lerp(begin.red, end.red, lerpAmount);
-            result.green = Lerp(begin.green, end.green, lerpAmount);
-            result.blue = Lerp(begin.blue, end.blue, lerpAmount);
-            result.v.normal.x = Lerp(begin.v.normal.x, end.v.normal.x, lerpAmount);
-            result.v.normal.y = Lerp(begin.v.normal.y, end.v.normal.y, lerpAmount);
-            result.v.normal.z = Lerp(begin.v.normal.z, end.v.normal.z, lerpAmount);
-            result.v.normal.w = Lerp(begin.v.normal.w, end.v.normal.w, lerpAmount);
-            result.v.materialId = begin.v.materialId;
-            return result;
+            return static_cast<float>(bits & 0xffff) / 65535.0f;
         }
 
-        Interpolant GetInterpolant(std::vector<VertexS>& vertices, const std::function<float(const VertexS& v)>& c)
+        static uint32_t PackSnorm16(float value)
         {
-            return Interpolant(
-                { vertices[0].v.position.x, vertices[0].v.position.y, c(vertices[0]) / vertices[0].v.position.w },
-                { vertices[1].v.position.x, vertices[1].v.position.y, c(vertices[1]) / vertices[1].v.position.w },
-                { vertices[2].v.position.x, vertices[2].v.position.y, c(vertices[2]) / vertices[2].v.position.w }
-            );
+            return (static_cast<uint32_t>(std::clamp(value, -1.0f, 1.0f) * 32767.0f + 32767.5f) - 32767) & 0xffff;
         }
 
-        void AddRawTriangle(Triangle& tr)
+        static float UnpackSnorm16(uint32_t bits)
         {
-            assert(tr.vertices.size() == 3);
+            return static_cast<float>(static_cast<int16_t>(bits & 0xffff)) / 32767.0f;
+        }
 
-            for (VertexS& v : tr.vertices)
+        static uint32_t PackUnorm8(float value)
+        {
+            return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+
+        // Direction is projected on the octahedron |x| + |y| + |z| = 1, and its lower half is folded over the upper one,
+        // so two coordinates are enough. Error is evenly spread over the sphere unlike with spherical coordinates.
+        static uint32_t PackNormal(const Vec& normal)
+        {
+            float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+            if (length == 0.0f)
             {
-                v.v.position.x /= v.v.position.w;
-                v.v.position.y /= v.v.position.w;
-                v.v.position.z /= v.v.position.w;
+                return 0;
             }
 
-            std::sort(std::begin(tr.vertices), std::end(tr.vertices), [](const VertexS& lhs, const VertexS& rhs) { return lhs.v.position.y < rhs.v.position.y; });
-
-            for (VertexS& v : tr.vertices)
+            float x = normal.x * (1.0f / length);
+            float y = normal.y * (1.0f / length);
+            if (normal.z < 0.0f)
             {
-                // todo.pavelza: Clipping might result in some vertices being slightly outside of -1 to 1 range, so we clamp. Will need to think how to avoid this.
-                v.v.position.x = std::clamp(v.v.position.x, -1.0f, 1.0f);
-                v.v.position.y = std::clamp(v.v.position.y, -1.0f, 1.0f);
-                v.v.position.z = std::clamp(v.v.position.z, -1.0f, 1.0f);
-
-                v.v.position.x = (OutputWidth - 1) * ((v.v.position.x + 1) / 2.0f);
-                v.v.position.y = (OutputHeight - 1) * ((v.v.position.y + 1) / 2.0f);
+                float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+                x = foldedX;
+                y = foldedY;
             }
 
-            tr.interpolants[0] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.red; });
-            tr.interpolants[1] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.green; });
-            tr.interpolants[2] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.blue; });
-
-            tr.interpolants[3] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.textureCoord.x; });
-            tr.interpolants[4] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.textureCoord.y; });
-
-            tr.interpolants[5] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.x; });
-            tr.interpolants[6] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.y; });
-            tr.interpolants[7] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.z; });
-
-            tr.interpolants[8] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.pos_view.x; });
-            tr.interpolants[9] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.pos_view.y; });
-            tr.interpolants[10] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.pos_view.z; });
-
-            tr.interpolants[11] = GetInterpolant(tr.vertices, [](const VertexS& v) { return 1.0f; });
-
-            // No division by w, because it is already divided by w.
-            tr.interpolants[12] = Interpolant(
-                { tr.vertices[0].v.position.x, tr.vertices[0].v.position.y, tr.vertices[0].v.position.z },
-                { tr.vertices[1].v.position.x, tr.vertices[1].v.position.y, tr.vertices[1].v.position.z },
-                { tr.vertices[2].v.position.x, tr.vertices[2].v.position.y, tr.vertices[2].v.position.z });
-
-            tr.texture = tr.vertices[0].v.materialId;
-
-            tr.minMax = Edge(tr.vertices[0].v.position, tr.vertices[2].v.position, true);
-            tr.minMiddle = Edge(tr.vertices[0].v.position, tr.vertices[1].v.position, true);
-            tr.middleMax = Edge(tr.vertices[1].v.position, tr.vertices[2].v.position, false);
+            return PackSnorm16(x) | (PackSnorm16(y) << 16);
         }
 
-        static bool IsVertexInside(const VertexS& point, int32_t axis, int32_t plane)
+        static Vec UnpackNormal(uint32_t bits)
         {
-            return point.v.position.Get(axis) * plane <= point.v.position.w;
+            float x = UnpackSnorm16(bits);
+            float y = UnpackSnorm16(bits >> 16);
+            float z = 1.0f - std::abs(x) - std::abs(y);
+
+            float fold = std::max(-z, 0.0f);
+            x += x >= 0.0f ? -fold : fold;
+            y += y >= 0.0f ? -fold : fold;
+
+            return { x, y, z, 0.0f };
         }
 
-        // todo.pavelza: There is an issue somewhere - we render black 1px line on the border sometimes when the triangle is outside of frustum (compared to dx12 renderer).
-        // And after introducing the backface culling we can sometimes see pixels from some triangles on the back in the first left 1px line.
-        // Looks like front triangle is clipped not precisely by frustum.
-        void ClipTrianglePlane(std::vector<VertexS>& vertices, int32_t axis, int32_t plane)
+        // Rounds to the nearest half float. Values too small for a normal half become zero, too big ones become infinity.
+        static uint16_t PackHalf(float value)
         {
-            std::vector<VertexS> result;
-            size_t previousElement = vertices.size() - 1;
+            uint32_t bits = std::bit_cast<uint32_t>(value);
+            uint32_t sign = (bits >> 16) & 0x8000;
+            int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+            uint32_t mantissa = bits & 0x7fffff;
 
-            for (size_t currentElement = 0; currentElement < vertices.size(); currentElement++)
+            if (exponent <= 0)
             {
-                bool isPreviousInside = IsVertexInside(vertices[previousElement], axis, plane);
-                bool isCurrentInside = IsVertexInside(vertices[currentElement], axis, plane);
-
-                if (isPreviousInside != isCurrentInside)
-                {
-                    float k = (vertices[previousElement].v.position.w - vertices[previousElement].v.position.Get(axis) * plane);
-                    float lerpAmount = k / (k - vertices[currentElement].v.position.w + vertices[currentElement].v.position.Get(axis) * plane);
-                    result.push_back(Lerp(vertices[previousElement], vertices[currentElement], lerpAmount));
-                }
-
-                if (isCurrentInside)
-                {
-                    result.push_back(vertices[currentElement]);
-                }
+                return static_cast<uint16_t>(sign);
+            }
 
-                previousElement = currentElement;
+            if (exponent >= 31)
+            {
+                return static_cast<uint16_t>(sign | 0x7c00);
             }
 
-            swap(vertices, result);
+            // Carry of the rounding goes to the exponent, which is still the correctly rounded value.
+            uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+            return static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
         }
 
-        bool ClipTriangleAxis(std::vector<VertexS>& vertices, int32_t axis)
+        static float UnpackHalf(uint16_t half)
         {
-            ClipTrianglePlane(vertices, axis, 1);
+            uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+            uint32_t exponent = (half >> 10) & 0x1f;
+            uint32_t mantissa = half & 0x3ff;
 
-            if (vertices.size() == 0)
+            if (exponent == 0)
             {
-                return false;
+                return std::bit_cast<float>(sign);
             }
 
-            ClipTrianglePlane(vertices, axis, -1);
+            if (exponent == 31)
+            {
+                return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+            }
 
-            return vertices.size() != 0;
+            return std::bit_cast<float>(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
         }
 
-        void AddTriangle(Triangle& tr, const Matrix& transform, std::vector<Triangle>& trianglesCache)
+        template<typename Layout>
+        void Write(const float* values)
         {
-            for (VertexS& v : tr.vertices)
-            {
-                v.v.position = PerspectiveTransform(scene.camera, static_cast<float>(OutputWidth), static_cast<float>(OutputHeight)) * transform * v.v.position;
-                v.pos_view = transform * v.pos_view;
-                // This is possible because we do not do non-uniform scale in transform. If we are about to do non-uniform scale, we should calculate the normal matrix.
-                v.v.normal = transform * v.v.normal;
-            }
+            float w = 1.0f / values[Layout::W];
 
-            // Backface culling produces very rough results in view space (maybe need to figure out why some day). So we do it in clip space. And it seems to be the right (identical to hardware) way.
-            // Doing clipspace culling before we split triangles that penetrate camera frustum gives us additional ~10ms gain for a frame in reference scene.
-            // Front is counter clockwise.
-            Vec v0 { tr.vertices[0].v.position.x / tr.vertices[0].v.position.w, tr.vertices[0].v.position.y / tr.vertices[0].v.position.w, tr.vertices[0].v.position.z / tr.vertices[0].v.position.w, 1.0f };
-            Vec v1 { tr.vertices[1].v.position.x / tr.vertices[1].v.position.w, tr.vertices[1].v.position.y / tr.vertices[1].v.position.w, tr.vertices[1].v.position.z / tr.vertices[1].v.position.w, 1.0f };
-            Vec v2 { tr.vertices[2].v.position.x / tr.vertices[2].v.position.w, tr.vertices[2].v.position.y / tr.vertices[2].v.position.w, tr.vertices[2].v.position.z / tr.vertices[2].v.position.w, 1.0f };
-            if (cross(v2 - v0, v1 - v0).z > 0)
+            // Direction of the normal does not change with division by w, as it is positive after near plane clipping.
+            normal = PackNormal({ values[Layout::Normal], values[Layout::Normal + 1], values[Layout::Normal + 2], 0.0f });
+
+            if constexpr (Layout::HasTextureCoord)
             {
-                return;
+                textureCoord = PackUnorm16(values[Layout::TextureCoord] * w) | (PackUnorm16(values[Layout::TextureCoord + 1] * w) << 16);
             }
 
-            // We must check that all triangle lies on outside of one of the planes,
-            // since if we check that some vertices lie on the outside of one plane and others on outside of the other,
-            // then part of the triangle might still be visible.
-            std::array<bool, 6> planesToOutsideness { false };
-            for (const VertexS& v : tr.vertices)
+            if constexpr (Layout::HasTint)
             {
-                planesToOutsideness[0] |= IsVertexInside(v, 0, 1);
-                planesToOutsideness[1] |= IsVertexInside(v, 1, 1);
-                planesToOutsideness[2] |= IsVertexInside(v, 2, 1);
-                planesToOutsideness[3] |= IsVertexInside(v, 0, -1);
-                planesToOutsideness[4] |= IsVertexInside(v, 1, -1);
-                planesToOutsideness[5] |= IsVertexInside(v, 2, -1);
+                tint = PackUnorm8(values[Layout::Tint] * w) | (PackUnorm8(values[Layout::Tint + 1] * w) << 8) | (PackUnorm8(values[Layout::Tint + 2] * w) << 16);
             }
+        }
 
-            // This check doesn't give us a big performance boost in a general case,
-            // but it doesn't seem to hit performance in general case too much to remove it either.
-            if (std::any_of(planesToOutsideness.begin(), planesToOutsideness.end(), [](bool val) { return !val; }))
+        template<typename Layout>
+        bool Read(float z, SurfaceAttributes& surface) const
+        {
+            if (z == ClearDepth)
             {
-                return;
+                return false;
             }
 
-            if (std::all_of(tr.vertices.begin(), tr.vertices.end(), [](const VertexS& v){ return IsVertexInside(v, 0, 1) && IsVertexInside(v, 1, 1) && IsVertexInside(v, 2, 1) && IsVertexInside(v, 0, -1) && IsVertexInside(v, 1, -1) && IsVertexInside(v, 2, -1); }))
+            surface.normal = UnpackNormal(normal);
+            surface.tint = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+            if constexpr (Layout::HasTextureCoord)
             {
-                AddRawTriangle(tr);
-                trianglesCache.push_back(std::move(tr));
-                return;
+                surface.texX = UnpackUnorm16(textureCoord);
+                surface.texY = UnpackUnorm16(textureCoord >> 16);
             }
 
-            std::vector<VertexS> vertices = std::move(tr.vertices);
-            if (ClipTriangleAxis(vertices, 0) && ClipTriangleAxis(vertices, 1) && ClipTriangleAxis(vertices, 2))
+            if constexpr (Layout::HasTint)
             {
-                assert(vertices.size() >= 3);
+                surface.tint = { (tint & 0xff) / 255.0f, ((tint >> 8) & 0xff) / 255.0f, ((tint >> 16) & 0xff) / 255.0f, 1.0f };
+            }
 
-                for (size_t i = 2; i < vertices.size(); i++)
-                {
-                    Triangle newTr;
-                    newTr.vertices.resize(3);
+            return true;
+        }
+    };
 
-                    newTr.vertices[0] = vertices[0];
-                    newTr.vertices[1] = vertices[i - 1];
-                    newTr.vertices[2] = vertices[i];
+    template<>
+    struct GBufferPixel<GBufferLayout::Packed> : PackedGBufferPixel
+    {
+        std::array<uint16_t, 3> viewPosition;
 
-                    AddRawTriangle(newTr);
-                    trianglesCache.push_back(std::move(newTr));
-                }
-            }
+        template<typename Layout>
+        void Write(const float* values, float, const Vec& position)
+        {
+            PackedGBufferPixel::Write<Layout>(values);
+            viewPosition = { PackHalf(position.x), PackHalf(position.y), PackHalf(position.z) };
         }
 
-        void GetTriangleFromModel(uint32_t index, const Model& model, Triangle& triangle)
+        template<typename Layout>
+        bool Read(float z, SurfaceAttributes& surface) const
         {
-            triangle.vertices.resize(3);
-
-            const Vertex& a = model.vertices[model.indices[index * 3 + 0]];
-            const Vertex& b = model.vertices[model.indices[index * 3 + 1]];
-            const Vertex& c = model.vertices[model.indices[index * 3 + 2]];
-
-            triangle.vertices[0] = VertexS{
-                a,
-                a.position,
-                a.color.GetVec().x,
-                a.color.GetVec().y,
-                a.color.GetVec().z
-            };
-
-            triangle.vertices[1] = VertexS{
-                b,
-                b.position,
-                b.color.GetVec().x,
-                b.color.GetVec().y,
-                b.color.GetVec().z
-            };
-
-            triangle.vertices[2] = VertexS{
-                c,
-                c.position,
-                c.color.GetVec().x,
-                c.color.GetVec().y,
-                c.color.GetVec().z
-            };
+            surface.viewPosition = { UnpackHalf(viewPosition[0]), UnpackHalf(viewPosition[1]), UnpackHalf(viewPosition[2]), 1.0f };
+            return PackedGBufferPixel::Read<Layout>(z, surface);
         }
     };
 
-    bool SceneRendererSoftware::Render(const Scene& scene, Texture& texture)
+    template<>
+    struct GBufferPixel<GBufferLayout::PackedDepth> : PackedGBufferPixel
     {
-        if (texture.GetWidth() == 0 || texture.GetHeight() == 0)
+        template<typename Layout>
+        void Write(const float* values, float, const Vec&)
         {
-            return false;
+            PackedGBufferPixel::Write<Layout>(values);
         }
+    };
 
-        if (context == nullptr || context->scene.name != scene.name)
-        {
-            context = std::make_shared<SceneRendererSoftwareContext>(scene);
-        }
+    static_assert(sizeof(GBufferPixel<GBufferLayout::Packed>) == 20 && sizeof(GBufferPixel<GBufferLayout::PackedDepth>) == 12);
 
-        context->OutputWidth = texture.GetWidth();
-        context->OutputHeight = texture.GetHeight();
+    // Screen is split into tiles, every tile is rasterized by a single thread, so depth and G buffer writes never race
+    // and the tile's part of the buffers stays in the cache of the core that works on it.
+    struct Tile
+    {
+        int32_t beginX = 0;
+        int32_t beginY = 0;
+        int32_t endX = 0;
+        int32_t endY = 0;
 
-        PERF_START("Clean buffers");
-        context->BackBuffer.resize(context->OutputWidth * context->OutputHeight);
-        context->ZBuffer.resize(context->OutputWidth * context->OutputHeight);
-        context->GBuffer.resize(context->OutputWidth * context->OutputHeight);
-        context->TBuffer.resize(context->OutputWidth * context->OutputHeight);
+        // Triangles in submission order, so the result does not depend on the order in which tiles are processed.
+        // Single pass mode sorts them front to back while rasterizing the tile.
+        std::vector<const Triangle*> triangles;
 
-        std::fill(context->BackBuffer.begin(), context->BackBuffer.end(), Color::Black.rgba);
-        std::fill(context->ZBuffer.begin(), context->ZBuffer.end(), 2.0f);
-        std::fill(context->TBuffer.begin(), context->TBuffer.end(), 0u);
-        PERF_END();
+        // Buffers of the tile are cleared when it gets triangles in any pass of the frame. Tiles, that never do, are background.
+        bool isCleared = false;
 
-        PERF_START("Clean G buffers");
-        auto r = std::ranges::iota_view<size_t, size_t>{ 0, context->GBuffer.size() };
-        std::for_each(std::execution::par, r.begin(), r.end(), [this](size_t i) { std::fill(context->GBuffer[i].begin(), context->GBuffer[i].end(), 0.0f); });
-        PERF_END();
+        // Pixels of the tile, that triangles cover, as indices into the screen buffers in row major order. Built by the tile's thread
+        // right after it is rasterized, so light culling and shading go over them only and the rest of the tile is filled with the background.
+        std::vector<uint32_t> fragments;
 
-        PERF_START("Light transform");
-        // calculate light's position in view space
-        context->light.position_view = ViewTransform(scene.camera) * scene.light.position;
-        context->light.light = scene.light;
-        PERF_END();
+        // Lights, that reach any of the covered pixels of the tile. Built before shading.
+        std::vector<uint32_t> lights;
 
-        PERF_START("Materials");
-        if (context->Textures.size() == 0)
-        {
-            context->Textures.resize(scene.models[0].materials.size());
-            for (size_t i = 0; i < context->Textures.size(); i++)
-            {
-                Load(scene.models[0].materials[i].textureName, context->Textures[i]);
-            }
-        }
-        PERF_END();
+        // Depth range of the whole tile after the depth pass. It is the coarsest level of hierarchical z.
+        float minZ = 0.0f;
+        float maxZ = 0.0f;
 
-        PERF_START("Triangle cache");
-        const Model& model = scene.models[0];
+        // Kept per tile, so threads do not share counters. Summed up after rasterization.
+        uint64_t hiZTestedBlocks = 0;
+        uint64_t hiZRejectedBlocks = 0;
 
-        static std::vector<Triangle> trianglesCache;
-        trianglesCache.reserve(model.indices.size() / 3 * 2);
-        trianglesCache.clear();
-        PERF_END();
+        // Pixels, that passed the depth test, and the ones of them, that passed it for the first time.
+        uint64_t depthWrittenPixels = 0;
+        uint64_t coveredPixels = 0;
+    };
 
-        PERF_START("Add triangles");
-        for (uint32_t i = 0; i < model.indices.size() / 3; i++)
-        {
-            Triangle triangle;
-            context->GetTriangleFromModel(i, model, triangle);
-            context->AddTriangle(triangle, ViewTransform(scene.camera), trianglesCache);
-        }
-        PERF_END();
+    // Floats of the 8 covered pixels, that the SIMD shading kernel works on at once. AVX2 builds keep them in one register,
+    // the others in two SSE registers. Both do the same operations in the same order, so results do not depend on the build.
+    struct ShadingLanes
+    {
+        static constexpr int32_t Count = 8;
+
+#ifdef __AVX2__
+        __m256 v;
+#else
+        __m128 lo;
+        __m128 hi;
+#endif
+    };
 
-        PERF_START("ZBuffer");
-        for (Triangle& tr : trianglesCache)
-        {
-            context->FillZBuffer(tr);
+    static ShadingLanes SetLanes(float value)
+    {
+#ifdef __AVX2__
+        return { _mm256_set1_ps(value) };
+#else
+        return { _mm_set1_ps(value), _mm_set1_ps(value) };
+#endif
+    }
+
+    // Values have to be aligned to 32 bytes.
+    static ShadingLanes LoadLanes(const float* values)
+    {
+#ifdef __AVX2__
+        return { _mm256_load_ps(values) };
+#else
+        return { _mm_load_ps(values), _mm_load_ps(values + 4) };
+#endif
+    }
+
+    static ShadingLanes operator+(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_add_ps(a.v, b.v) };
+#else
+        return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes operator-(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_sub_ps(a.v, b.v) };
+#else
+        return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes operator*(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_mul_ps(a.v, b.v) };
+#else
+        return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes operator/(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_div_ps(a.v, b.v) };
+#else
+        return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes operator*(const ShadingLanes& a, float b)
+    {
+        return a * SetLanes(b);
+    }
+
+    // Takes b, where a is NaN, like std::max with b first does.
+    static ShadingLanes MaxLanes(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_max_ps(a.v, b.v) };
+#else
+        return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes MinLanes(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_min_ps(a.v, b.v) };
+#else
+        return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) };
+#endif
+    }
+
+    static ShadingLanes SqrtLanes(const ShadingLanes& a)
+    {
+#ifdef __AVX2__
+        return { _mm256_sqrt_ps(a.v) };
+#else
+        return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) };
+#endif
+    }
+
+    // Lanes of the result have all bits set, where a is greater than b, and are zero elsewhere.
+    static ShadingLanes GreaterLanes(const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) };
+#else
+        return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) };
+#endif
+    }
+
+    // Takes a, where the mask is set, and b elsewhere.
+    static ShadingLanes SelectLanes(const ShadingLanes& mask, const ShadingLanes& a, const ShadingLanes& b)
+    {
+#ifdef __AVX2__
+        return { _mm256_blendv_ps(b.v, a.v, mask.v) };
+#else
+        return { _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)), _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)) };
+#endif
+    }
+
+    // Bit per lane, that is set, where the mask is.
+    static int32_t MaskBits(const ShadingLanes& mask)
+    {
+#ifdef __AVX2__
+        return _mm256_movemask_ps(mask.v);
+#else
+        return _mm_movemask_ps(mask.lo) | (_mm_movemask_ps(mask.hi) << 4);
+#endif
+    }
+
+    // Rounds towards zero, values have to fit into int32_t.
+    static ShadingLanes TruncateLanes(const ShadingLanes& a)
+    {
+#ifdef __AVX2__
+        return { _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a.v)) };
+#else
+        return { _mm_cvtepi32_ps(_mm_cvttps_epi32(a.lo)), _mm_cvtepi32_ps(_mm_cvttps_epi32(a.hi)) };
+#endif
+    }
+
+    // Splits positive normal floats into the exponent and the mantissa from 1 to 2.
+    static ShadingLanes SplitExponentLanes(const ShadingLanes& a, ShadingLanes& mantissa)
+    {
+#ifdef __AVX2__
+        __m256i bits = _mm256_castps_si256(a.v);
+        mantissa = { _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000))) };
+        return { _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127))) };
+#else
+        __m128i bitsLo = _mm_castps_si128(a.lo);
+        __m128i bitsHi = _mm_castps_si128(a.hi);
+        mantissa = {
+            _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bitsLo, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000))),
+            _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bitsHi, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)))
+        };
+        return {
+            _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bitsLo, 23), _mm_set1_epi32(127))),
+            _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bitsHi, 23), _mm_set1_epi32(127)))
+        };
+#endif
+    }
+
+    // Returns 2 to the power of whole exponents from -126 to 127.
+    static ShadingLanes Pow2Lanes(const ShadingLanes& exponent)
+    {
+#ifdef __AVX2__
+        return { _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(exponent.v), _mm256_set1_epi32(127)), 23)) };
+#else
+        return {
+            _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(exponent.lo), _mm_set1_epi32(127)), 23)),
+            _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(exponent.hi), _mm_set1_epi32(127)), 23))
+        };
+#endif
+    }
+
+    // Approximates pow for bases from 0 to 1 as exp2(exponent * log2(base)). Relative error grows with the exponent and stays
+    // below 1e-5 for shininess up to 32, so colors rarely differ from the scalar pow after the truncation to bytes.
+    static ShadingLanes PowLanes(const ShadingLanes& base, float exponent)
+    {
+        if (exponent == 0.0f)
+        {
+            return SetLanes(1.0f);
+        }
+
+        // Base is split into mantissa from sqrt(0.5) to sqrt(2) and exponent, logarithm of the mantissa comes from the series of atanh.
+        // Zero base gets the smallest normal float, whose power is zero in bytes.
+        ShadingLanes mantissa;
+        ShadingLanes baseExponent = SplitExponentLanes(MaxLanes(base, SetLanes(std::numeric_limits<float>::min())), mantissa);
+        ShadingLanes isAboveSqrt2 = GreaterLanes(mantissa, SetLanes(1.41421356f));
+        mantissa = SelectLanes(isAboveSqrt2, mantissa * 0.5f, mantissa);
+        baseExponent = SelectLanes(isAboveSqrt2, baseExponent + SetLanes(1.0f), baseExponent);
+
+        ShadingLanes t = (mantissa - SetLanes(1.0f)) / (mantissa + SetLanes(1.0f));
+        ShadingLanes t2 = t * t;
+        ShadingLanes series = SetLanes(1.0f / 9.0f);
+        series = series * t2 + SetLanes(1.0f / 7.0f);
+        series = series * t2 + SetLanes(1.0f / 5.0f);
+        series = series * t2 + SetLanes(1.0f / 3.0f);
+        series = series * t2 + SetLanes(1.0f);
+        ShadingLanes logarithm = baseExponent + t * series * (2.0f / 0.693147181f);
+
+        // Power is split into whole exponent and fraction, whose exp comes from the Taylor series around the middle of the range.
+        ShadingLanes power = MinLanes(MaxLanes(logarithm * exponent, SetLanes(-126.0f)), SetLanes(127.0f));
+        ShadingLanes whole = TruncateLanes(power);
+        whole = SelectLanes(GreaterLanes(whole, power), whole - SetLanes(1.0f), whole);
+        ShadingLanes x = (power - whole - SetLanes(0.5f)) * 0.693147181f;
+
+        ShadingLanes exponential = SetLanes(1.0f / 5040.0f);
+        exponential = exponential * x + SetLanes(1.0f / 720.0f);
+        exponential = exponential * x + SetLanes(1.0f / 120.0f);
+        exponential = exponential * x + SetLanes(1.0f / 24.0f);
+        exponential = exponential * x + SetLanes(1.0f / 6.0f);
+        exponential = exponential * x + SetLanes(0.5f);
+        exponential = exponential * x + SetLanes(1.0f);
+        exponential = exponential * x + SetLanes(1.0f);
+
+        return exponential * 1.41421356f * Pow2Lanes(whole);
+    }
+
+    // Converts colors to bytes of the output texture the same way PackColor does for a single one.
+    static void PackColorLanes(const ShadingLanes& r, const ShadingLanes& g, const ShadingLanes& b, uint32_t* pixels)
+    {
+        ShadingLanes zero = SetLanes(0.0f);
+        ShadingLanes one = SetLanes(1.0f);
+        ShadingLanes red = MinLanes(MaxLanes(r, zero), one) * 255.0f;
+        ShadingLanes green = MinLanes(MaxLanes(g, zero), one) * 255.0f;
+        ShadingLanes blue = MinLanes(MaxLanes(b, zero), one) * 255.0f;
+
+#ifdef __AVX2__
+        __m256i bytes = _mm256_or_si256(_mm256_cvttps_epi32(red.v), _mm256_slli_epi32(_mm256_cvttps_epi32(green.v), 8));
+        bytes = _mm256_or_si256(bytes, _mm256_slli_epi32(_mm256_cvttps_epi32(blue.v), 16));
+        bytes = _mm256_or_si256(bytes, _mm256_set1_epi32(static_cast<int32_t>(0xFF000000)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels), bytes);
+#else
+        __m128i bytesLo = _mm_or_si128(_mm_cvttps_epi32(red.lo), _mm_slli_epi32(_mm_cvttps_epi32(green.lo), 8));
+        __m128i bytesHi = _mm_or_si128(_mm_cvttps_epi32(red.hi), _mm_slli_epi32(_mm_cvttps_epi32(green.hi), 8));
+        bytesLo = _mm_or_si128(bytesLo, _mm_slli_epi32(_mm_cvttps_epi32(blue.lo), 16));
+        bytesHi = _mm_or_si128(bytesHi, _mm_slli_epi32(_mm_cvttps_epi32(blue.hi), 16));
+        bytesLo = _mm_or_si128(bytesLo, _mm_set1_epi32(static_cast<int32_t>(0xFF000000)));
+        bytesHi = _mm_or_si128(bytesHi, _mm_set1_epi32(static_cast<int32_t>(0xFF000000)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), bytesLo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), bytesHi);
+#endif
+    }
+
+    struct SceneRendererSoftwareContext
+    {
+        SceneRendererSoftwareContext(const Scene& scene): scene(scene) {}
+
+        const Scene& scene;
+        SceneRendererSoftware::Settings settings;
+
+        size_t OutputWidth = 0;
+        size_t OutputHeight = 0;
+
+        std::vector<float> ZBuffer;
+
+        // Textures and vertex colors of all models are kept in one array each in the order of the models, which does not change for the scene.
+        std::vector<ModelResources> Models;
+        std::vector<Texture> Textures;
+        std::vector<Vec> Colors;
+        std::vector<LightS> Lights;
+
+        TransformedVertices Vertices;
+
+        // Size of the guard band in the clip space units, 1 being the screen edge. Triangles, that stay inside of it, are not clipped
+        // by x and y planes, the parts outside of the screen are skipped by the rasterizer. Limited, so fixed point coordinates do not overflow.
+        static constexpr float GuardBand = 16.0f;
+        static constexpr uint8_t ZPlanes = 0b110000;
+
+        std::vector<ModelBatch> Batches;
+        std::vector<std::pair<uint32_t, uint32_t>> VertexRanges;
+        uint64_t CulledTriangles = 0;
+        uint64_t ConeCulledTriangles = 0;
+
+        // Max depth pyramid kept from the previous frame. Clusters behind it are not drawn in the first pass of the frame, but tested
+        // again against the pyramid of the first pass, which is also the one kept for the next frame.
+        struct DepthPyramidLevel
+        {
+            size_t offset = 0;
+            size_t width = 0;
+            size_t height = 0;
+        };
+
+        struct OccludedCluster
+        {
+            uint32_t batch = 0;
+            const Cluster* cluster = nullptr;
+        };
+
+        std::vector<float> DepthPyramid;
+        std::vector<DepthPyramidLevel> DepthPyramidLevels;
+        std::vector<OccludedCluster> OccludedClusters;
+        bool TestOcclusion = false;
+        uint64_t OccludedTriangles = 0;
+        static constexpr uint32_t VerticesPerChunk = 4096;
+        std::vector<GeometryChunk> VertexChunks;
+
+        // Triangles are set up in parallel over chunks of the models' triangles. Every chunk has its own output and chunks are
+        // binned in order, so the result is the same as if the triangles were added one by one, model after model.
+        static constexpr uint32_t TrianglesPerChunk = 1024;
+        std::vector<GeometryChunk> TriangleChunkRanges;
+        std::vector<std::vector<Triangle>> TriangleChunks;
+
+        // Only the buffer of the layout selected by the settings is resized, the others keep what they had.
+        std::vector<GBufferPixel<GBufferLayout::Explicit>> ExplicitGBuffer;
+        std::vector<GBufferPixel<GBufferLayout::Packed>> PackedGBuffer;
+        std::vector<GBufferPixel<GBufferLayout::PackedDepth>> PackedDepthGBuffer;
+        std::vector<uint32_t> TBuffer;
+
+        // Perspective transform of the frame, view position is reconstructed from depth with it.
+        Matrix Projection;
+
+        // Used instead of G and T buffers in visibility buffer mode. Triangles are indexed by their id.
+        std::vector<uint32_t> IdBuffer;
+        std::vector<const Triangle*> Triangles;
+
+        // Buffers are not cleared for the whole screen. Tile's thread clears its part of the depth buffer and hierarchical z
+        // right before rasterizing it, so it is written while it gets into the cache anyway. Tiles without triangles are not
+        // cleared at all and shading takes their pixels as background. G, T and id buffers are read only where the depth
+        // buffer is covered, so they are never cleared.
+        static constexpr size_t TileSize = 64;
+        size_t TilesX = 0;
+        std::vector<Tile> Tiles;
+
+        static constexpr int32_t BlockSize = 8;
+        static constexpr int32_t SimdWidth = 4;
+        static_assert((InterpolantsSize - 1) % SimdWidth == 0);
+        static_assert(TileSize % BlockSize == 0 && BlockSize % SimdWidth == 0);
+
+        // Hierarchical z keeps min and max depth of every 8x8 block of the depth buffer, the same blocks half-space kernel walks.
+        // Blocks of a tile, that a triangle might touch, are kept as a bit mask with a bit per block in row major order.
+        static constexpr int32_t BlocksPerTileRow = static_cast<int32_t>(TileSize) / BlockSize;
+        static_assert(BlocksPerTileRow * BlocksPerTileRow <= 64);
+        // Interpolated z might be slightly out of the triangle's vertices range due to rounding, so the tests are conservative.
+        static constexpr float HiZEpsilon = 1e-5f;
+        size_t HiZWidth;
+        size_t HiZHeight;
+        std::vector<float> HiZMin;
+        std::vector<float> HiZMax;
+
+        // Inputs of the previous frame, compared to the ones of the current frame to tell, which stages have to run again.
+        // Geometry is told changed by its buffers and the version, that callers increment after editing it in place.
+        struct ModelState
+        {
+            const Vertex* vertices = nullptr;
+            size_t verticesCount = 0;
+            const uint32_t* indices = nullptr;
+            size_t indicesCount = 0;
+            uint32_t version = 0;
+        };
+
+        struct CameraState
+        {
+            Vec position;
+            float pitch = 0.0f;
+            float yaw = 0.0f;
+            float nearPlane = 0.0f;
+            float farPlane = 0.0f;
+            float fieldOfView = 0.0f;
+        };
+
+        struct ModelPlacement
+        {
+            Vec position;
+            bool backfaceCulling = true;
+        };
+
+        std::vector<ModelState> ModelStates;
+        std::vector<std::string> TextureNames;
+        std::vector<ModelPlacement> ModelPlacements;
+        std::vector<Instance> Instances;
+        CameraState Camera;
+        std::vector<Light> LightStates;
+
+        // Size of the texture, that the last frame was rendered to. It is rendered from scratch, if the size changes.
+        size_t TextureWidth = 0;
+        size_t TextureHeight = 0;
+
+        // Buffer and the first pixel of the texture, that the last frame was written to. If nothing changed, but the texture is another one,
+        // the buffers of the last frame are shaded to it again. Pixel tells a new texture allocated at the address of the previous one,
+        // as new textures are zeroed, while the frame's pixels are opaque.
+        const uint8_t* TextureBuffer = nullptr;
+        uint32_t TextureFirstPixel = 0;
+
+        // With a target frame time, frames are rendered to the scaled texture and upsampled to the output. Scale is picked from the times
+        // of the previous frame, whose vertex stages and upsampling are taken as fixed cost and the others as proportional to the number of pixels.
+        float ResolutionScale = 1.0f;
+        Texture ScaledTexture;
+
+        // Scale changes only by more than this part of it, so the resolution does not switch every frame with the noise of the timings.
+        // Changing it resizes the buffers and drops the depth pyramid of the previous frame.
+        static constexpr float ResolutionScaleThreshold = 0.05f;
+
+        void UpdateResolutionScale(float fixedTime, float frameTime)
+        {
+            float minScale = std::clamp(settings.minResolutionScale, 0.0f, 1.0f);
+            float scale = minScale;
+            if (settings.targetFrameTime <= 0.0f)
+            {
+                scale = 1.0f;
+            }
+            else if (settings.targetFrameTime > fixedTime)
+            {
+                float pixelsTime = std::max(frameTime - fixedTime, std::numeric_limits<float>::min());
+                scale = std::clamp(ResolutionScale * std::sqrt((settings.targetFrameTime - fixedTime) / pixelsTime), minScale, 1.0f);
+            }
+
+            // Halfway to the picked scale, as the timings of a single frame overshoot. Scales close to the limits snap to them.
+            scale = ResolutionScale + (scale - ResolutionScale) * 0.5f;
+            float threshold = ResolutionScale * ResolutionScaleThreshold;
+            if (scale - minScale < threshold)
+            {
+                ResolutionScale = minScale;
+            }
+            else if (1.0f - scale < threshold)
+            {
+                ResolutionScale = 1.0f;
+            }
+            else if (std::abs(scale - ResolutionScale) >= threshold)
+            {
+                ResolutionScale = scale;
+            }
+        }
+
+        // Bilinear filter between centers of the texels. Positions in the source are stepped in 16.16 fixed point, weights are 8 bit.
+        static void Upsample(const Texture& source, Texture& target)
+        {
+            const uint32_t* input = reinterpret_cast<const uint32_t*>(source.GetBuffer());
+            uint32_t* output = reinterpret_cast<uint32_t*>(target.GetBuffer());
+            int32_t sourceWidth = static_cast<int32_t>(source.GetWidth());
+            int32_t sourceHeight = static_cast<int32_t>(source.GetHeight());
+            int32_t targetWidth = static_cast<int32_t>(target.GetWidth());
+            int32_t targetHeight = static_cast<int32_t>(target.GetHeight());
+            int32_t stepX = static_cast<int32_t>((static_cast<int64_t>(sourceWidth) << 16) / targetWidth);
+            int32_t stepY = static_cast<int32_t>((static_cast<int64_t>(sourceHeight) << 16) / targetHeight);
+            int32_t maxX = (sourceWidth - 1) << 16;
+            int32_t maxY = (sourceHeight - 1) << 16;
+
+            // Lerps all 4 channels at once, two in each half of the 64 bit value.
+            auto spread = [](uint32_t color) { return (color & 0x00FF00FFull) | ((color & 0xFF00FF00ull) << 24); };
+            auto lerp = [](uint64_t a, uint64_t b, uint64_t weight) { return (a * (256 - weight) + b * weight + 0x0080008000800080ull) >> 8 & 0x00FF00FF00FF00FFull; };
+
+            auto r = std::ranges::iota_view<int32_t, int32_t>{ 0, targetHeight };
+            std::for_each(std::execution::par, r.begin(), r.end(), [=](int32_t y) {
+                int32_t sourceY = std::clamp(stepY / 2 - (1 << 15) + y * stepY, 0, maxY);
+                const uint32_t* row0 = input + (sourceY >> 16) * sourceWidth;
+                const uint32_t* row1 = input + std::min((sourceY >> 16) + 1, sourceHeight - 1) * sourceWidth;
+                uint64_t weightY = (sourceY & 0xFFFF) >> 8;
+
+                int32_t sourceX = stepX / 2 - (1 << 15);
+                for (int32_t x = 0; x < targetWidth; x++, sourceX += stepX)
+                {
+                    int32_t clampedX = std::clamp(sourceX, 0, maxX);
+                    int32_t x0 = clampedX >> 16;
+                    int32_t x1 = std::min(x0 + 1, sourceWidth - 1);
+                    uint64_t weightX = (clampedX & 0xFFFF) >> 8;
+
+                    uint64_t top = lerp(spread(row0[x0]), spread(row0[x1]), weightX);
+                    uint64_t bottom = lerp(spread(row1[x0]), spread(row1[x1]), weightX);
+                    uint64_t color = lerp(top, bottom, weightY);
+                    output[y * targetWidth + x] = static_cast<uint32_t>((color & 0x00FF00FF) | ((color >> 24) & 0xFF00FF00));
+                }
+            });
+        }
+
+        // Bytes held by the buffers, which are kept between frames. Buffers only grow, so if it has not changed during a frame, nothing was allocated for them.
+        size_t GetBuffersCapacity() const
+        {
+            auto capacity = [](const auto& buffer) { return buffer.capacity() * sizeof(buffer[0]); };
+
+            size_t result = capacity(ZBuffer) + capacity(ExplicitGBuffer) + capacity(PackedGBuffer) + capacity(PackedDepthGBuffer) + capacity(TBuffer) + capacity(IdBuffer) + capacity(HiZMin) + capacity(HiZMax);
+            result += capacity(ModelStates) + capacity(TextureNames) + capacity(ModelPlacements) + capacity(Instances);
+            result += capacity(Vertices.positions) + capacity(Vertices.normals) + capacity(Vertices.outsidePlanes) + capacity(Vertices.outsideGuardBand);
+            result += capacity(Models) + capacity(Colors) + capacity(Lights) + capacity(LightStates) + capacity(Batches) + capacity(VertexRanges) + capacity(DepthPyramid) + capacity(DepthPyramidLevels) + capacity(OccludedClusters) + capacity(VertexChunks) + capacity(TriangleChunkRanges) + capacity(TriangleChunks) + capacity(Triangles) + capacity(Tiles);
+
+            for (const std::vector<Triangle>& triangles : TriangleChunks)
+            {
+                result += capacity(triangles);
+            }
+
+            for (const Tile& tile : Tiles)
+            {
+                result += capacity(tile.triangles) + capacity(tile.fragments) + capacity(tile.lights);
+            }
+
+            return result;
+        }
+
+        float Lerp(float begin, float end, float lerpAmount)
+        {
+            return begin + (end - begin) * lerpAmount;
+        }
+
+        // Interpolants along a scanline span. Deltas per pixel are calculated once for the span, so a pixel takes a multiply-add
+        // per interpolant instead of a division. Values are evaluated from the span's begin rather than accumulated, so z of
+        // a pixel does not depend on which pixels before it were skipped, and the equality test of the attribute pass holds.
+        struct Span
+        {
+            Span(const EdgeSample& left, const EdgeSample& right)
+                : beginX(left.pixelX)
+                , stepScale(1.0f / static_cast<float>(right.pixelX - left.pixelX))
+                , z(left.currentC[ZInterpolant])
+                , zStep((right.currentC[ZInterpolant] - left.currentC[ZInterpolant]) * stepScale)
+            {
+            }
+
+            // Attributes are set up only by the passes, that write them, as edge samples of the others have just z.
+            template<typename Layout>
+            void SetupAttributes(const EdgeSample& left, const EdgeSample& right)
+            {
+                __m128 scale = _mm_set1_ps(stepScale);
+                for (uint32_t i = 0; i < Layout::PaddedCount / SimdWidth; i++)
+                {
+                    values[i] = _mm_loadu_ps(&left.currentC[i * SimdWidth]);
+                    steps[i] = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&right.currentC[i * SimdWidth]), values[i]), scale);
+                }
+            }
+
+            float Z(int32_t x) const
+            {
+                return z + static_cast<float>(x - beginX) * zStep;
+            }
+
+            template<typename Layout>
+            void Interpolate(int32_t x, float* result) const
+            {
+                __m128 offset = _mm_set1_ps(static_cast<float>(x - beginX));
+                for (uint32_t i = 0; i < Layout::PaddedCount / SimdWidth; i++)
+                {
+                    _mm_store_ps(&result[i * SimdWidth], _mm_add_ps(values[i], _mm_mul_ps(offset, steps[i])));
+                }
+            }
+
+            int32_t beginX;
+            float stepScale;
+            float z;
+            float zStep;
+            std::array<__m128, (InterpolantsSize - 1) / SimdWidth> values;
+            std::array<__m128, (InterpolantsSize - 1) / SimdWidth> steps;
+        };
+
+        template<typename Layout, RasterPass Pass>
+        void FillZBuffer(const Triangle& tr, Tile& tile, uint64_t visibleBlocks)
+        {
+            int32_t yBegin = std::max(tr.minMax.pixelYBegin, tile.beginY);
+            int32_t yEnd = std::min(tr.minMax.pixelYEnd, tile.endY);
+
+            EdgeSample leftSample;
+            EdgeSample rightSample;
+
+            for (int32_t y = yBegin; y < yEnd; y++)
+            {
+                uint32_t rowBlocks = GetRowBlocks(visibleBlocks, tile, y);
+                if (rowBlocks == 0)
+                {
+                    continue;
+                }
+
+                const Edge* rightEdge = y >= tr.middleMax.pixelYBegin ? &tr.middleMax : &tr.minMiddle;
+
+                if constexpr (Pass == RasterPass::DepthAttributes)
+                {
+                    tr.minMax.CalculateC<Layout>(tr.interpolants, y, leftSample);
+                    rightEdge->CalculateC<Layout>(tr.interpolants, y, rightSample);
+                }
+                else
+                {
+                    tr.minMax.CalculateCForZOnly(tr.interpolants, y, leftSample);
+                    rightEdge->CalculateCForZOnly(tr.interpolants, y, rightSample);
+                }
+
+                EdgeSample* left = &leftSample;
+                EdgeSample* right = &rightSample;
+
+                if (left->pixelX > right->pixelX)
+                {
+                    std::swap(left, right);
+                }
+
+                // Span is still set up for the whole scanline, so the result does not depend on the tile size.
+                int32_t xBegin = std::max(left->pixelX, tile.beginX);
+                int32_t xEnd = std::min(right->pixelX, tile.endX);
+                if (xBegin >= xEnd)
+                {
+                    continue;
+                }
+
+                Span span(*left, *right);
+                if constexpr (Pass == RasterPass::DepthAttributes)
+                {
+                    span.SetupAttributes<Layout>(*left, *right);
+                }
+
+                for (int32_t x = xBegin; x < xEnd; x++)
+                {
+                    int32_t block = (x - tile.beginX) / BlockSize;
+                    if ((rowBlocks & (1u << block)) == 0)
+                    {
+                        // Jump to the last pixel of the rejected block.
+                        x = tile.beginX + (block + 1) * BlockSize - 1;
+                        continue;
+                    }
+
+                    float z = span.Z(x);
+                    if (z < ZBuffer[y * OutputWidth + x])
+                    {
+                        tile.depthWrittenPixels++;
+                        tile.coveredPixels += ZBuffer[y * OutputWidth + x] == ClearDepth;
+                        ZBuffer[y * OutputWidth + x] = z;
+
+                        if constexpr (Pass == RasterPass::Visibility)
+                        {
+                            IdBuffer[y * OutputWidth + x] = tr.id;
+                        }
+                        else if constexpr (Pass == RasterPass::DepthAttributes)
+                        {
+                            alignas(16) std::array<float, Layout::PaddedCount> values;
+                            span.Interpolate<Layout>(x, values.data());
+                            WriteGBuffer<Layout>(y * OutputWidth + x, values.data(), z, tr.texture);
+                        }
+                    }
+                }
+            }
+        }
+
+        template<typename Layout>
+        void FillGBuffer(const Triangle& tr, const Tile& tile, uint64_t visibleBlocks)
+        {
+            int32_t yBegin = std::max(tr.minMax.pixelYBegin, tile.beginY);
+            int32_t yEnd = std::min(tr.minMax.pixelYEnd, tile.endY);
+
+            EdgeSample leftSample;
+            EdgeSample rightSample;
+
+            for (int32_t y = yBegin; y < yEnd; y++)
+            {
+                uint32_t rowBlocks = GetRowBlocks(visibleBlocks, tile, y);
+                if (rowBlocks == 0)
+                {
+                    continue;
+                }
+
+                const Edge* rightEdge = y >= tr.middleMax.pixelYBegin ? &tr.middleMax : &tr.minMiddle;
+
+                tr.minMax.CalculateC<Layout>(tr.interpolants, y, leftSample);
+                rightEdge->CalculateC<Layout>(tr.interpolants, y, rightSample);
+
+                EdgeSample* left = &leftSample;
+                EdgeSample* right = &rightSample;
+
+                if (left->pixelX > right->pixelX)
+                {
+                    std::swap(left, right);
+                }
+
+                int32_t xBegin = std::max(left->pixelX, tile.beginX);
+                int32_t xEnd = std::min(right->pixelX, tile.endX);
+                if (xBegin >= xEnd)
+                {
+                    continue;
+                }
+
+                Span span(*left, *right);
+                span.SetupAttributes<Layout>(*left, *right);
+
+                for (int32_t x = xBegin; x < xEnd; x++)
+                {
+                    int32_t block = (x - tile.beginX) / BlockSize;
+                    if ((rowBlocks & (1u << block)) == 0)
+                    {
+                        // Jump to the last pixel of the rejected block.
+                        x = tile.beginX + (block + 1) * BlockSize - 1;
+                        continue;
+                    }
+
+                    float z = span.Z(x);
+                    if (z == ZBuffer[y * OutputWidth + x])
+                    {
+                        alignas(16) std::array<float, Layout::PaddedCount> values;
+                        span.Interpolate<Layout>(x, values.data());
+                        WriteGBuffer<Layout>(y * OutputWidth + x, values.data(), z, tr.texture);
+                    }
+                }
+            }
+        }
+
+        // Blocks of the tile's block row, that contains the given pixel row, one bit per block.
+        static uint32_t GetRowBlocks(uint64_t visibleBlocks, const Tile& tile, int32_t y)
+        {
+            int32_t blockRow = (y - tile.beginY) / BlockSize;
+            return static_cast<uint32_t>(visibleBlocks >> (blockRow * BlocksPerTileRow)) & ((1u << BlocksPerTileRow) - 1);
+        }
+
+        void UpdateHiZBlock(int32_t blockX, int32_t blockY, const Tile& tile)
+        {
+            int32_t xBegin = blockX * BlockSize;
+            int32_t xEnd = std::min(xBegin + BlockSize, tile.endX);
+            int32_t yBegin = blockY * BlockSize;
+            int32_t yEnd = std::min(yBegin + BlockSize, tile.endY);
+
+            float minZ = std::numeric_limits<float>::max();
+            float maxZ = std::numeric_limits<float>::lowest();
+            for (int32_t y = yBegin; y < yEnd; y++)
+            {
+                for (int32_t x = xBegin; x < xEnd; x++)
+                {
+                    float z = ZBuffer[y * OutputWidth + x];
+                    minZ = std::min(minZ, z);
+                    maxZ = std::max(maxZ, z);
+                }
+            }
+
+            HiZMin[blockY * HiZWidth + blockX] = minZ;
+            HiZMax[blockY * HiZWidth + blockX] = maxZ;
+        }
+
+        // Called after the depth pass of the tile, so the attribute pass sees exact depth ranges.
+        void UpdateHiZ(Tile& tile)
+        {
+            tile.minZ = std::numeric_limits<float>::max();
+            tile.maxZ = std::numeric_limits<float>::lowest();
+
+            for (int32_t blockY = tile.beginY / BlockSize; blockY * BlockSize < tile.endY; blockY++)
+            {
+                for (int32_t blockX = tile.beginX / BlockSize; blockX * BlockSize < tile.endX; blockX++)
+                {
+                    UpdateHiZBlock(blockX, blockY, tile);
+                    tile.minZ = std::min(tile.minZ, HiZMin[blockY * HiZWidth + blockX]);
+                    tile.maxZ = std::max(tile.maxZ, HiZMax[blockY * HiZWidth + blockX]);
+                }
+            }
+        }
+
+        // Returns the blocks of the tile, that the triangle overlaps and that are not rejected by hierarchical z.
+        // Depth pass rejects blocks, where the closest point of the triangle is not closer than the farthest stored z. Stored max z
+        // is only lowered by the depth pass, so blocks written since their last update are marked dirty and updated only when
+        // the stale value fails to reject. Attribute pass rejects blocks, where depth ranges of the triangle and the block do not intersect.
+        template<bool IsDepthPass>
+        uint64_t GetVisibleBlocks(const Triangle& tr, Tile& tile, uint64_t& dirtyBlocks)
+        {
+            int32_t xBegin = std::max(tr.boundsBeginX, tile.beginX);
+            int32_t xEnd = std::min(tr.boundsEndX, tile.endX);
+            int32_t yBegin = std::max(tr.boundsBeginY, tile.beginY);
+            int32_t yEnd = std::min(tr.boundsEndY, tile.endY);
+
+            if (xBegin >= xEnd || yBegin >= yEnd)
+            {
+                return 0;
+            }
+
+            float minZ = tr.minZ - HiZEpsilon;
+            float maxZ = tr.maxZ + HiZEpsilon;
+
+            bool isTileRejected = false;
+            if constexpr (!IsDepthPass)
+            {
+                isTileRejected = settings.useHierarchicalZ && (minZ > tile.maxZ || maxZ < tile.minZ);
+            }
+
+            uint64_t visibleBlocks = 0;
+            for (int32_t blockY = yBegin / BlockSize; blockY * BlockSize < yEnd; blockY++)
+            {
+                for (int32_t blockX = xBegin / BlockSize; blockX * BlockSize < xEnd; blockX++)
+                {
+                    uint64_t bit = 1ull << ((blockY - tile.beginY / BlockSize) * BlocksPerTileRow + blockX - tile.beginX / BlockSize);
+
+                    if (!settings.useHierarchicalZ)
+                    {
+                        visibleBlocks |= bit;
+                        continue;
+                    }
+
+                    size_t block = blockY * HiZWidth + blockX;
+                    bool isVisible = !isTileRejected;
+
+                    if constexpr (IsDepthPass)
+                    {
+                        isVisible = minZ < HiZMax[block];
+                        if (isVisible && (dirtyBlocks & bit))
+                        {
+                            UpdateHiZBlock(blockX, blockY, tile);
+                            dirtyBlocks &= ~bit;
+                            isVisible = minZ < HiZMax[block];
+                        }
+
+                        if (isVisible)
+                        {
+                            dirtyBlocks |= bit;
+                        }
+                    }
+                    else if (isVisible)
+                    {
+                        isVisible = minZ <= HiZMax[block] && maxZ >= HiZMin[block];
+                    }
+
+                    tile.hiZTestedBlocks++;
+                    if (isVisible)
+                    {
+                        visibleBlocks |= bit;
+                    }
+                    else
+                    {
+                        tile.hiZRejectedBlocks++;
+                    }
+                }
+            }
+
+            return visibleBlocks;
+        }
+
+        static __m128 LaneMask(int32_t mask)
+        {
+            const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), laneBits), laneBits));
+        }
+
+        void ResizeGBuffer(size_t size)
+        {
+            switch (settings.gBufferLayout)
+            {
+            case GBufferLayout::Explicit:
+                ExplicitGBuffer.resize(size);
+                break;
+            case GBufferLayout::Packed:
+                PackedGBuffer.resize(size);
+                break;
+            case GBufferLayout::PackedDepth:
+                PackedDepthGBuffer.resize(size);
+                break;
+            }
+        }
+
+        // Layout does not change within a frame, so the branch on it is predicted for every pixel.
+        template<typename Layout>
+        void WriteGBuffer(size_t pixel, const float* values, float z, uint32_t texture)
+        {
+            switch (settings.gBufferLayout)
+            {
+            case GBufferLayout::Explicit:
+                WriteGBufferPixel<Layout>(ExplicitGBuffer[pixel], pixel, values, z);
+                break;
+            case GBufferLayout::Packed:
+                WriteGBufferPixel<Layout>(PackedGBuffer[pixel], pixel, values, z);
+                break;
+            case GBufferLayout::PackedDepth:
+                WriteGBufferPixel<Layout>(PackedDepthGBuffer[pixel], pixel, values, z);
+                break;
+            }
+
+            TBuffer[pixel] = texture;
+        }
+
+        template<typename Layout, GBufferLayout PixelLayout>
+        void WriteGBufferPixel(GBufferPixel<PixelLayout>& gBufferPixel, size_t pixel, const float* values, float z) const
+        {
+            Vec viewPosition;
+            if constexpr (PixelLayout == GBufferLayout::Packed)
+            {
+                viewPosition = ReconstructViewPosition(pixel % OutputWidth, pixel / OutputWidth, z);
+            }
+
+            gBufferPixel.template Write<Layout>(values, z, viewPosition);
+        }
+
+        // Inverse of the perspective transform for a pixel, which maps view z to w = -z and z * m[10] + m[11] before division by w.
+        // Depth is interpolated linearly in screen space, which is exact for it, so the result matches perspective correct interpolation.
+        Vec ReconstructViewPosition(size_t x, size_t y, float z) const
+        {
+            float viewZ = -Projection.m[11] / (z + Projection.m[10]);
+            float ndcX = 2.0f * x / std::max<size_t>(OutputWidth - 1, 1) - 1.0f;
+            float ndcY = 2.0f * y / std::max<size_t>(OutputHeight - 1, 1) - 1.0f;
+
+            return { -viewZ * ndcX / Projection.m[0], -viewZ * ndcY / Projection.m[5], viewZ, 1.0f };
+        }
+
+        // Returns false, if no triangle covers the pixel.
+        template<typename Layout>
+        bool ReadGBuffer(size_t pixel, SurfaceAttributes& surface) const
+        {
+            switch (settings.gBufferLayout)
+            {
+            case GBufferLayout::Explicit:
+                return ReadGBufferPixel<Layout>(ExplicitGBuffer[pixel], pixel, surface);
+            case GBufferLayout::Packed:
+                return ReadGBufferPixel<Layout>(PackedGBuffer[pixel], pixel, surface);
+            case GBufferLayout::PackedDepth:
+                return ReadGBufferPixel<Layout>(PackedDepthGBuffer[pixel], pixel, surface);
+            }
+
+            return false;
+        }
+
+        template<typename Layout, GBufferLayout PixelLayout>
+        bool ReadGBufferPixel(const GBufferPixel<PixelLayout>& gBufferPixel, size_t pixel, SurfaceAttributes& surface) const
+        {
+            if (!gBufferPixel.template Read<Layout>(ZBuffer[pixel], surface))
+            {
+                return false;
+            }
+
+            if constexpr (PixelLayout != GBufferLayout::Packed)
+            {
+                surface.viewPosition = ReconstructViewPosition(pixel % OutputWidth, pixel / OutputWidth, ZBuffer[pixel]);
+            }
+
+            return true;
+        }
+
+        // Writes interpolants for the pixels of the lanes set in the mask. Interpolants are evaluated once for the first lane and stepped for the others.
+        template<typename Layout>
+        void WriteInterpolants(const HalfSpaceSetup& setup, int32_t x, int32_t y, int32_t mask, const std::array<float, SimdWidth>& z, uint32_t texture)
+        {
+            __m128 dx = _mm_set1_ps(x - setup.originX);
+            __m128 dy = _mm_set1_ps(y - setup.originY);
+
+            constexpr uint32_t Vectors = Layout::PaddedCount / SimdWidth;
+            __m128 values[Vectors];
+            __m128 stepsX[Vectors];
+            for (uint32_t i = 0; i < Vectors; i++)
+            {
+                stepsX[i] = _mm_load_ps(&setup.stepX[i * SimdWidth]);
+                __m128 stepY = _mm_load_ps(&setup.stepY[i * SimdWidth]);
+                values[i] = _mm_add_ps(_mm_load_ps(&setup.c[i * SimdWidth]), _mm_add_ps(_mm_mul_ps(dx, stepsX[i]), _mm_mul_ps(dy, stepY)));
+            }
+
+            for (int32_t lane = 0; lane < SimdWidth; lane++)
+            {
+                if (mask & (1 << lane))
+                {
+                    size_t pixel = y * OutputWidth + x + lane;
+
+                    alignas(16) std::array<float, Vectors * SimdWidth> interpolants;
+                    __m128 laneOffset = _mm_set1_ps(static_cast<float>(lane));
+                    for (uint32_t i = 0; i < Vectors; i++)
+                    {
+                        _mm_store_ps(&interpolants[i * SimdWidth], _mm_add_ps(values[i], _mm_mul_ps(laneOffset, stepsX[i])));
+                    }
+
+                    WriteGBuffer<Layout>(pixel, interpolants.data(), z[lane], texture);
+                }
+            }
+        }
+
+        // Coverage is exact and z of a pixel depends only on its position, so the equality of attribute pass holds whichever blocks are walked.
+        template<typename Layout, RasterPass Pass>
+        void RasterizeHalfSpace(const Triangle& tr, Tile& tile, uint64_t visibleBlocks)
+        {
+            enum class Coverage : uint8_t
+            {
+                None,
+                Partial,
+                Full
+            };
+
+            const HalfSpaceSetup& setup = tr.halfSpace;
+
+            int32_t xBegin = std::max(tr.boundsBeginX, tile.beginX);
+            int32_t xEnd = std::min(tr.boundsEndX, tile.endX);
+            int32_t yBegin = std::max(tr.boundsBeginY, tile.beginY);
+            int32_t yEnd = std::min(tr.boundsEndY, tile.endY);
+
+            const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+            // Edges are kept in separate variables rather than in an array, so the compiler keeps them in registers while stepping.
+            // Every edge takes two registers of 64 bit values: lanes 0 and 1 in the low one, lanes 2 and 3 in the high one.
+            const EdgeFunction& edge0 = setup.edges[0];
+            const EdgeFunction& edge1 = setup.edges[1];
+            const EdgeFunction& edge2 = setup.edges[2];
+
+            const __m128i edge0GroupStep = _mm_set1_epi64x(edge0.stepX * SimdWidth);
+            const __m128i edge1GroupStep = _mm_set1_epi64x(edge1.stepX * SimdWidth);
+            const __m128i edge2GroupStep = _mm_set1_epi64x(edge2.stepX * SimdWidth);
+
+            const __m128 zStepX = _mm_set1_ps(setup.z.stepX);
+            const __m128 zLaneSteps = _mm_mul_ps(laneOffsets, zStepX);
+
+            // Snapped triangle might cover pixels slightly outside of the original one, where z is extrapolated, thin triangles have steep z.
+            // Clamping keeps z in the triangle's range, which hierarchical z relies on.
+            const __m128 zMin = _mm_set1_ps(tr.minZ);
+            const __m128 zMax = _mm_set1_ps(tr.maxZ);
+
+            // Tiles are aligned to blocks, so lanes out of the triangle bounds are still in the tile and are left to the edge tests.
+            // Only the lanes past the end of the tile are masked out.
+            int32_t firstBlockX = xBegin - xBegin % BlockSize;
+
+            for (int32_t blockY = yBegin - yBegin % BlockSize; blockY < yEnd; blockY += BlockSize)
+            {
+                uint32_t rowBlocks = GetRowBlocks(visibleBlocks, tile, blockY);
+                if (rowBlocks == 0)
+                {
+                    continue;
+                }
+
+                // Edge functions are linear, so their extremes over the block are in its corners.
+                // Triangle is convex, so only the range between the first and the last covered blocks needs to be walked.
+                std::array<Coverage, TileSize / BlockSize> blocks;
+                int32_t coveredBegin = xEnd;
+                int32_t coveredEnd = xBegin;
+                for (int32_t blockX = firstBlockX, block = 0; blockX < xEnd; blockX += BlockSize, block++)
+                {
+                    if ((rowBlocks & (1u << ((blockX - tile.beginX) / BlockSize))) == 0)
+                    {
+                        blocks[block] = Coverage::None;
+                        continue;
+                    }
+
+                    bool isOutside = false;
+                    bool isInside = true;
+                    for (const EdgeFunction& edge : setup.edges)
+                    {
+                        int64_t corner = edge.At(blockX, blockY);
+                        int64_t extentX = edge.stepX * (BlockSize - 1);
+                        int64_t extentY = edge.stepY * (BlockSize - 1);
+
+                        isOutside |= corner + std::max<int64_t>(extentX, 0) + std::max<int64_t>(extentY, 0) < 0;
+                        isInside &= corner + std::min<int64_t>(extentX, 0) + std::min<int64_t>(extentY, 0) >= 0;
+                    }
+
+                    blocks[block] = isOutside ? Coverage::None : (isInside ? Coverage::Full : Coverage::Partial);
+                    if (!isOutside)
+                    {
+                        coveredBegin = std::min(coveredBegin, blockX);
+                        coveredEnd = std::min(blockX + BlockSize, xEnd);
+                    }
+                }
+
+                if (coveredBegin >= coveredEnd)
+                {
+                    continue;
+                }
+
+                // Blocks of the row are walked line by line, so memory is accessed in the same order as it is laid out.
+                int32_t rowBegin = std::max(blockY, yBegin);
+                int32_t rowEnd = std::min(blockY + BlockSize, yEnd);
+
+                for (int32_t y = rowBegin; y < rowEnd; y++)
+                {
+                    auto edgeLanes = [coveredBegin, y](const EdgeFunction& edge, __m128i& low, __m128i& high)
+                    {
+                        int64_t value = edge.At(coveredBegin, y);
+                        low = _mm_set_epi64x(value + edge.stepX, value);
+                        high = _mm_set_epi64x(value + edge.stepX * 3, value + edge.stepX * 2);
+                    };
+
+                    __m128i edge0Low, edge0High, edge1Low, edge1High, edge2Low, edge2High;
+                    edgeLanes(edge0, edge0Low, edge0High);
+                    edgeLanes(edge1, edge1Low, edge1High);
+                    edgeLanes(edge2, edge2Low, edge2High);
+
+                    // Covered range differs between the passes, as hierarchical z rejects different blocks in them. So z is calculated from
+                    // the same row start for every group instead of being stepped, to keep it bit exact between the passes.
+                    __m128 zRow = _mm_add_ps(_mm_set1_ps(setup.z.At(static_cast<float>(firstBlockX), static_cast<float>(y))), zLaneSteps);
+
+                    float* zLine = &ZBuffer[y * OutputWidth];
+
+                    for (int32_t x = coveredBegin; x < coveredEnd; x += SimdWidth)
+                    {
+                        Coverage coverage = blocks[(x - firstBlockX) / BlockSize];
+
+                        if (coverage != Coverage::None)
+                        {
+                            __m128 z = _mm_add_ps(zRow, _mm_mul_ps(_mm_set1_ps(static_cast<float>(x - firstBlockX)), zStepX));
+
+                            bool isWholeGroupInTile = x + SimdWidth <= tile.endX;
+                            int32_t mask = isWholeGroupInTile ? (1 << SimdWidth) - 1 : (1 << (tile.endX - x)) - 1;
+
+                            if (coverage == Coverage::Partial)
+                            {
+                                // Pixel is outside if any of the edge functions is negative, sign bits of 64 bit lanes are collected as doubles.
+                                __m128i outsideLow = _mm_or_si128(_mm_or_si128(edge0Low, edge1Low), edge2Low);
+                                __m128i outsideHigh = _mm_or_si128(_mm_or_si128(edge0High, edge1High), edge2High);
+                                int32_t outside = _mm_movemask_pd(_mm_castsi128_pd(outsideLow)) | (_mm_movemask_pd(_mm_castsi128_pd(outsideHigh)) << 2);
+                                mask &= ~outside;
+                            }
+
+                            if (mask != 0)
+                            {
+                                RasterizeGroup<Layout, Pass>(tr, tile, x, y, mask, _mm_min_ps(_mm_max_ps(z, zMin), zMax), zLine + x, isWholeGroupInTile);
+                            }
+                        }
+
+                        edge0Low = _mm_add_epi64(edge0Low, edge0GroupStep);
+                        edge0High = _mm_add_epi64(edge0High, edge0GroupStep);
+                        edge1Low = _mm_add_epi64(edge1Low, edge1GroupStep);
+                        edge1High = _mm_add_epi64(edge1High, edge1GroupStep);
+                        edge2Low = _mm_add_epi64(edge2Low, edge2GroupStep);
+                        edge2High = _mm_add_epi64(edge2High, edge2GroupStep);
+                    }
+                }
+            }
+        }
+
+        // When all lanes are inside of the tile, it is safe to access the whole group in the buffers with a single load.
+        template<typename Layout, RasterPass Pass>
+        void RasterizeGroup(const Triangle& tr, Tile& tile, int32_t x, int32_t y, int32_t mask, __m128 z, float* zGroup, bool isWholeGroupInTile)
+        {
+            constexpr bool IsDepthPass = Pass != RasterPass::Attributes;
+            constexpr bool WritesAttributes = Pass == RasterPass::Attributes || Pass == RasterPass::DepthAttributes;
+            uint32_t* idGroup = Pass == RasterPass::Visibility ? &IdBuffer[y * OutputWidth + x] : nullptr;
+
+            if (isWholeGroupInTile)
+            {
+                __m128 zOld = _mm_loadu_ps(zGroup);
+
+                if constexpr (IsDepthPass)
+                {
+                    __m128 isCloser = _mm_and_ps(_mm_cmplt_ps(z, zOld), LaneMask(mask));
+                    _mm_storeu_ps(zGroup, _mm_or_ps(_mm_and_ps(isCloser, z), _mm_andnot_ps(isCloser, zOld)));
+
+                    mask = _mm_movemask_ps(isCloser);
+                    tile.depthWrittenPixels += std::popcount(static_cast<uint32_t>(mask));
+                    tile.coveredPixels += std::popcount(static_cast<uint32_t>(mask & _mm_movemask_ps(_mm_cmpeq_ps(zOld, _mm_set1_ps(ClearDepth)))));
+
+                    if constexpr (Pass == RasterPass::Visibility)
+                    {
+                        __m128i isCloserId = _mm_castps_si128(isCloser);
+                        __m128i idOld = _mm_loadu_si128(reinterpret_cast<const __m128i*>(idGroup));
+                        __m128i id = _mm_or_si128(_mm_and_si128(isCloserId, _mm_set1_epi32(tr.id)), _mm_andnot_si128(isCloserId, idOld));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(idGroup), id);
+                    }
+
+                    if constexpr (!WritesAttributes)
+                    {
+                        return;
+                    }
+                }
+                else
+                {
+                    mask &= _mm_movemask_ps(_mm_cmpeq_ps(z, zOld));
+                }
+            }
+
+            alignas(16) std::array<float, SimdWidth> zLanes;
+            _mm_store_ps(zLanes.data(), z);
+
+            if (!isWholeGroupInTile)
+            {
+                for (int32_t lane = 0; lane < SimdWidth; lane++)
+                {
+                    if (mask & (1 << lane))
+                    {
+                        if constexpr (IsDepthPass)
+                        {
+                            if (zLanes[lane] < zGroup[lane])
+                            {
+                                tile.depthWrittenPixels++;
+                                tile.coveredPixels += zGroup[lane] == ClearDepth;
+                                zGroup[lane] = zLanes[lane];
+
+                                if constexpr (Pass == RasterPass::Visibility)
+                                {
+                                    idGroup[lane] = tr.id;
+                                }
+                            }
+                            else
+                            {
+                                mask &= ~(1 << lane);
+                            }
+                        }
+                        else if (zLanes[lane] != zGroup[lane])
+                        {
+                            mask &= ~(1 << lane);
+                        }
+                    }
+                }
+            }
+
+            if constexpr (WritesAttributes)
+            {
+                if (mask != 0)
+                {
+                    WriteInterpolants<Layout>(tr.halfSpace, x, y, mask, zLanes, tr.texture);
+                }
+            }
+        }
+
+        void SetupTiles()
+        {
+            TilesX = (OutputWidth + TileSize - 1) / TileSize;
+            size_t tilesY = (OutputHeight + TileSize - 1) / TileSize;
+
+            Tiles.resize(TilesX * tilesY);
+            for (size_t tileY = 0; tileY < tilesY; tileY++)
+            {
+                for (size_t tileX = 0; tileX < TilesX; tileX++)
+                {
+                    Tile& tile = Tiles[tileY * TilesX + tileX];
+                    tile.beginX = static_cast<int32_t>(tileX * TileSize);
+                    tile.beginY = static_cast<int32_t>(tileY * TileSize);
+                    tile.endX = static_cast<int32_t>(std::min((tileX + 1) * TileSize, OutputWidth));
+                    tile.endY = static_cast<int32_t>(std::min((tileY + 1) * TileSize, OutputHeight));
+                    tile.isCleared = false;
+                    tile.fragments.clear();
+                    tile.hiZTestedBlocks = 0;
+                    tile.hiZRejectedBlocks = 0;
+                    tile.depthWrittenPixels = 0;
+                    tile.coveredPixels = 0;
+                }
+            }
+        }
+
+        // Ids of triangles are kept unique over both passes for the visibility buffer.
+        void BinTriangles(size_t firstChunk)
+        {
+            int32_t tilesX = static_cast<int32_t>((OutputWidth + TileSize - 1) / TileSize);
+            if (firstChunk == 0)
+            {
+                Triangles.clear();
+            }
+
+            for (Tile& tile : Tiles)
+            {
+                tile.triangles.clear();
+            }
+
+            for (Triangle& tr : TriangleChunks | std::views::drop(firstChunk) | std::views::join)
+            {
+                if (tr.boundsBeginX >= tr.boundsEndX || tr.boundsBeginY >= tr.boundsEndY)
+                {
+                    continue;
+                }
+
+                tr.id = static_cast<uint32_t>(Triangles.size());
+                Triangles.push_back(&tr);
+
+                int32_t tileXBegin = tr.boundsBeginX / TileSize;
+                int32_t tileXEnd = (tr.boundsEndX - 1) / TileSize;
+                int32_t tileYBegin = tr.boundsBeginY / TileSize;
+                int32_t tileYEnd = (tr.boundsEndY - 1) / TileSize;
+
+                for (int32_t tileY = tileYBegin; tileY <= tileYEnd; tileY++)
+                {
+                    for (int32_t tileX = tileXBegin; tileX <= tileXEnd; tileX++)
+                    {
+                        Tiles[tileY * tilesX + tileX].triangles.push_back(&tr);
+                    }
+                }
+            }
+        }
+
+        template<typename Layout, RasterPass Pass>
+        void RasterizeTriangle(const Triangle& tr, Tile& tile, uint64_t& dirtyBlocks)
+        {
+            uint64_t visibleBlocks = GetVisibleBlocks<Pass != RasterPass::Attributes>(tr, tile, dirtyBlocks);
+            if (visibleBlocks == 0)
+            {
+                return;
+            }
+
+            if (settings.rasterKernel == SceneRendererSoftware::RasterKernel::HalfSpace)
+            {
+                RasterizeHalfSpace<Layout, Pass>(tr, tile, visibleBlocks);
+            }
+            else if constexpr (Pass == RasterPass::Attributes)
+            {
+                FillGBuffer<Layout>(tr, tile, visibleBlocks);
+            }
+            else
+            {
+                FillZBuffer<Layout, Pass>(tr, tile, visibleBlocks);
+            }
+        }
+
+        // Models with and without textures can be mixed in a tile, so the layout is selected per triangle.
+        template<RasterPass Pass>
+        void RasterizeTriangle(const Triangle& tr, Tile& tile, uint64_t& dirtyBlocks)
+        {
+            if (tr.IsTextured())
+            {
+                RasterizeTriangle<TexturedLayout, Pass>(tr, tile, dirtyBlocks);
+            }
+            else
+            {
+                RasterizeTriangle<ColoredLayout, Pass>(tr, tile, dirtyBlocks);
+            }
+        }
+
+        const Tile& GetTile(size_t x, size_t y) const
+        {
+            return Tiles[(y / TileSize) * TilesX + x / TileSize];
+        }
+
+        // Hierarchical z is cleared to the same value as the depth buffer, so nothing is rejected until the blocks are covered.
+        void ClearTile(const Tile& tile)
+        {
+            for (int32_t y = tile.beginY; y < tile.endY; y++)
+            {
+                std::fill_n(ZBuffer.begin() + y * OutputWidth + tile.beginX, tile.endX - tile.beginX, ClearDepth);
+            }
+
+            int32_t blocksX = (tile.endX - tile.beginX + BlockSize - 1) / BlockSize;
+            for (int32_t blockY = tile.beginY / BlockSize; blockY * BlockSize < tile.endY; blockY++)
+            {
+                size_t rowBegin = blockY * HiZWidth + tile.beginX / BlockSize;
+                std::fill_n(HiZMin.begin() + rowBegin, blocksX, ClearDepth);
+                std::fill_n(HiZMax.begin() + rowBegin, blocksX, ClearDepth);
+            }
+        }
+
+        void RasterizeTile(Tile& tile)
+        {
+            if (tile.triangles.empty())
+            {
+                return;
+            }
+
+            if (!tile.isCleared)
+            {
+                ClearTile(tile);
+                tile.isCleared = true;
+            }
+
+            uint64_t dirtyBlocks = 0;
+
+            // Visibility buffer is done in a single pass, attributes are interpolated while shading.
+            if (settings.useVisibilityBuffer)
+            {
+                for (const Triangle* tr : tile.triangles)
+                {
+                    RasterizeTriangle<RasterPass::Visibility>(*tr, tile, dirtyBlocks);
+                }
+
+                return;
+            }
+
+            // Attributes of every pixel, that passes the depth test, are written, so closer triangles go first to be overwritten less
+            // and to let hierarchical z reject more. Order is by the nearest vertex, which is coarse for overlapping triangles,
+            // ties are broken by submission order to keep the result stable.
+            if (settings.useSinglePass)
+            {
+                std::sort(tile.triangles.begin(), tile.triangles.end(), [](const Triangle* lhs, const Triangle* rhs) {
+                    return std::tie(lhs->minZ, lhs->id) < std::tie(rhs->minZ, rhs->id);
+                });
+
+                for (const Triangle* tr : tile.triangles)
+                {
+                    RasterizeTriangle<RasterPass::DepthAttributes>(*tr, tile, dirtyBlocks);
+                }
+
+                return;
+            }
+
+            for (const Triangle* tr : tile.triangles)
+            {
+                RasterizeTriangle<RasterPass::Depth>(*tr, tile, dirtyBlocks);
+            }
+
+            if (settings.useHierarchicalZ && tile.triangles.size() > 0)
+            {
+                UpdateHiZ(tile);
+            }
+
+            for (const Triangle* tr : tile.triangles)
+            {
+                RasterizeTriangle<RasterPass::Attributes>(*tr, tile, dirtyBlocks);
+            }
+        }
+
+        // Evaluates the triangle's interpolants at the pixel the same way the attribute pass does, relative to the first vertex.
+        template<typename Layout>
+        void InterpolateAttributes(const Triangle& tr, int32_t x, int32_t y, std::array<float, InterpolantsSize>& interpolants) const
+        {
+            float dx = x - tr.vertices[0].v.position.x;
+            float dy = y - tr.vertices[0].v.position.y;
+
+            for (uint32_t i = 0; i < Layout::Count; i++)
+            {
+                interpolants[i] = tr.interpolants[i].CalculateC(dx, dy, true);
+            }
+
+            interpolants[ZInterpolant] = ZBuffer[y * OutputWidth + x];
+        }
+
+        // Pixels of the output texture keep bytes in r, g, b, a order, so opaque black has just the highest byte of alpha set.
+        static constexpr uint32_t BackgroundColor = 0xFF000000;
+
+        // Converts color to bytes of the output texture, truncating channels like Color does. Alpha is always opaque.
+        static uint32_t PackColor(const Vec& color)
+        {
+            __m128 channels = _mm_setr_ps(color.x, color.y, color.z, 1.0f);
+            channels = _mm_min_ps(_mm_max_ps(channels, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i bytes = _mm_cvttps_epi32(_mm_mul_ps(channels, _mm_set1_ps(255.0f)));
+            bytes = _mm_packs_epi32(bytes, bytes);
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(bytes, bytes)));
+        }
+
+        // Lights with radius are kept in the lists of the tiles, whose view space box around the covered pixels they reach. The box spans
+        // the corner pixels of the tile between the closest and the farthest covered depth, so it contains every position shaded in the tile.
+        void CullLights()
+        {
+            bool hasRadius = std::any_of(Lights.begin(), Lights.end(), [](const LightS& light) { return light.light.radius > 0.0f; });
+
+            std::for_each(std::execution::par, Tiles.begin(), Tiles.end(), [this, hasRadius](Tile& tile) {
+                tile.lights.clear();
+                if (!tile.isCleared)
+                {
+                    return;
+                }
+
+                if (!settings.useLightCulling || !hasRadius)
+                {
+                    for (uint32_t i = 0; i < Lights.size(); i++)
+                    {
+                        tile.lights.push_back(i);
+                    }
+
+                    return;
+                }
+
+                float minZ = std::numeric_limits<float>::max();
+                float maxZ = std::numeric_limits<float>::lowest();
+                for (uint32_t i : tile.fragments)
+                {
+                    minZ = std::min(minZ, ZBuffer[i]);
+                    maxZ = std::max(maxZ, ZBuffer[i]);
+                }
+
+                if (minZ > maxZ)
+                {
+                    return;
+                }
+
+                Bounds bounds {
+                    { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), 1.0f },
+                    { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), 1.0f }
+                };
+
+                for (uint32_t corner = 0; corner < 8; corner++)
+                {
+                    Vec position = ReconstructViewPosition(corner & 1 ? tile.endX - 1 : tile.beginX, corner & 2 ? tile.endY - 1 : tile.beginY, corner & 4 ? maxZ : minZ);
+                    bounds.min = { std::min(bounds.min.x, position.x), std::min(bounds.min.y, position.y), std::min(bounds.min.z, position.z), 1.0f };
+                    bounds.max = { std::max(bounds.max.x, position.x), std::max(bounds.max.y, position.y), std::max(bounds.max.z, position.z), 1.0f };
+                }
+
+                for (uint32_t i = 0; i < Lights.size(); i++)
+                {
+                    const LightS& light = Lights[i];
+                    float radius = light.light.radius;
+                    if (radius > 0.0f)
+                    {
+                        Vec closest {
+                            std::clamp(light.position_view.x, bounds.min.x, bounds.max.x),
+                            std::clamp(light.position_view.y, bounds.min.y, bounds.max.y),
+                            std::clamp(light.position_view.z, bounds.min.z, bounds.max.z),
+                            1.0f
+                        };
+
+                        Vec offset = light.position_view - closest;
+                        if (dot(offset, offset) >= radius * radius)
+                        {
+                            continue;
+                        }
+                    }
+
+                    tile.lights.push_back(i);
+                }
+            });
+        }
+
+        // Writes final colors straight into the texture. Its rows go from top to bottom, while pixels here are numbered from the bottom row.
+        // Tiles are filled with the background first and then only their fragments are shaded, so kernels never see uncovered pixels.
+        void ShadePixels(Texture& texture)
+        {
+            assert(texture.GetWidth() == OutputWidth && texture.GetHeight() == OutputHeight);
+            uint32_t* output = reinterpret_cast<uint32_t*>(texture.GetBuffer());
+
+            std::for_each(std::execution::par, Tiles.begin(), Tiles.end(), [this, output](const Tile& tile) {
+                for (int32_t y = tile.beginY; y < tile.endY; y++)
+                {
+                    std::fill_n(&output[(OutputHeight - 1 - y) * OutputWidth + tile.beginX], tile.endX - tile.beginX, BackgroundColor);
+                }
+
+                if (settings.shadingKernel == SceneRendererSoftware::ShadingKernel::Simd)
+                {
+                    for (size_t first = 0; first < tile.fragments.size(); first += ShadingLanes::Count)
+                    {
+                        int32_t count = static_cast<int32_t>(std::min<size_t>(ShadingLanes::Count, tile.fragments.size() - first));
+                        ShadeFragments(tile, &tile.fragments[first], count, output);
+                    }
+
+                    return;
+                }
+
+                for (uint32_t i : tile.fragments)
+                {
+                    uint32_t& pixel = output[(OutputHeight - 1 - i / OutputWidth) * OutputWidth + i % OutputWidth];
+                    uint32_t texture = GetMaterial(i);
+                    if (texture != NoTexture)
+                    {
+                        ShadePixel<TexturedLayout>(i, texture, tile, pixel);
+                    }
+                    else
+                    {
+                        ShadePixel<ColoredLayout>(i, texture, tile, pixel);
+                    }
+                }
+            });
+        }
+
+        // Layout of the pixel's attributes is the one of the triangle, that covers it, which is told by its texture.
+        uint32_t GetMaterial(int32_t i) const
+        {
+            return settings.useVisibilityBuffer ? Triangles[IdBuffer[i]]->texture : TBuffer[i];
+        }
+
+        // Returns false, if no triangle covers the pixel.
+        template<typename Layout>
+        bool ReadSurface(int32_t i, SurfaceAttributes& surface) const
+        {
+            if (settings.useVisibilityBuffer)
+            {
+                const Triangle& tr = *Triangles[IdBuffer[i]];
+                std::array<float, InterpolantsSize> interpolants;
+                InterpolateAttributes<Layout>(tr, i % OutputWidth, i / OutputWidth, interpolants);
+                UnpackInterpolants<Layout>(interpolants, surface);
+                surface.viewPosition = ReconstructViewPosition(i % OutputWidth, i / OutputWidth, ZBuffer[i]);
+                return true;
+            }
+
+            return ReadGBuffer<Layout>(i, surface);
+        }
+
+        // Color of the surface before lighting.
+        template<typename Layout>
+        Vec GetAlbedo(const SurfaceAttributes& surface, uint32_t materialId) const
+        {
+            if constexpr (Layout::HasTextureCoord)
+            {
+                assert(Textures[materialId].GetHeight() > 0 && Textures[materialId].GetWidth() > 0);
+
+                // From 0 to TextureWidth - 1 (TextureWidth pixels in total)
+                size_t textureX = static_cast<size_t>(surface.texX * (Textures[materialId].GetWidth() - 1));
+                // From 0 to TextureHeight - 1 (TextureHeight pixels in total)
+                size_t textureY = static_cast<size_t>(surface.texY * (Textures[materialId].GetHeight() - 1));
+
+                textureY = (Textures[materialId].GetHeight() - 1) - textureY; // invert texture coords
+
+                assert(textureY < Textures[materialId].GetHeight() && textureX < Textures[materialId].GetWidth());
+                size_t texelBase = textureY * Textures[materialId].GetWidth() + textureX;
+
+                return Textures[materialId].GetColor(texelBase).GetVec();
+            }
+
+            return surface.tint;
+        }
+
+        // Reference for the SIMD kernel, which has to match it up to the rounding of specular highlights.
+        template<typename Layout>
+        void ShadePixel(int32_t i, uint32_t materialId, const Tile& tile, uint32_t& pixel) const
+        {
+            SurfaceAttributes surface;
+            if (!ReadSurface<Layout>(i, surface))
+            {
+                return;
+            }
+
+            Vec pos_view = surface.viewPosition;
+            Vec normal_vec = normalize(surface.normal);
+
+            Vec lighting;
+            for (uint32_t lightIndex : tile.lights)
+            {
+                const LightS& light = Lights[lightIndex];
+                Vec light_vec = light.position_view - pos_view;
+
+                // Falls off to exactly zero at the radius, so culling lights by it does not change the result.
+                float attenuation = 1.0f;
+                if (light.light.radius > 0.0f)
+                {
+                    float falloff = std::max(1.0f - dot(light_vec, light_vec) / (light.light.radius * light.light.radius), 0.0f);
+                    attenuation = falloff * falloff;
+                    if (attenuation == 0.0f)
+                    {
+                        continue;
+                    }
+                }
+
+                light_vec = normalize(light_vec);
+
+                Vec diffuse = light.light.color.GetVec() * static_cast<float>(std::max<float>(dot(normal_vec, light_vec), 0.0f));
+                Vec ambient = light.light.color.GetVec() * light.light.ambientStrength;
+
+                float specAmount = static_cast<float>(std::max<float>(dot(normalize(pos_view), reflect(normal_vec, light_vec * -1.0f)), 0.0f));
+                Vec specular = light.light.color.GetVec() * pow(specAmount, light.light.specularShininess) * light.light.specularStrength;
+
+                lighting = lighting + (diffuse + ambient + specular) * attenuation;
+            }
+
+            Vec final_color = lighting * GetAlbedo<Layout>(surface, materialId);
+            pixel = PackColor(final_color);
+        }
+
+        // Attributes of the fragments, that are shaded at once, kept by components, so every one of them loads straight into lanes.
+        struct ShadingBatch
+        {
+            alignas(32) std::array<float, ShadingLanes::Count> normal[3];
+            alignas(32) std::array<float, ShadingLanes::Count> position[3];
+            alignas(32) std::array<float, ShadingLanes::Count> albedo[3];
+        };
+
+        // Shades up to 8 fragments of the tile. Surfaces of the fragments are read one by one into the batch, which the lighting
+        // runs on at once. Math is the one of ShadePixel in the same order, so only pow differs, which is approximated.
+        void ShadeFragments(const Tile& tile, const uint32_t* fragments, int32_t count, uint32_t* output) const
+        {
+            // Lanes past the count and of fragments without a surface get one facing the camera, so their math stays finite, and are not written.
+            ShadingBatch batch;
+            for (uint32_t component = 0; component < 3; component++)
+            {
+                batch.normal[component].fill(component == 2 ? 1.0f : 0.0f);
+                batch.position[component].fill(component == 2 ? -1.0f : 0.0f);
+                batch.albedo[component].fill(0.0f);
+            }
+
+            int32_t coverage = 0;
+            for (int32_t lane = 0; lane < count; lane++)
+            {
+                int32_t i = static_cast<int32_t>(fragments[lane]);
+                SurfaceAttributes surface;
+                Vec albedo;
+                uint32_t texture = GetMaterial(i);
+                if (texture != NoTexture)
+                {
+                    if (!ReadSurface<TexturedLayout>(i, surface))
+                    {
+                        continue;
+                    }
+
+                    albedo = GetAlbedo<TexturedLayout>(surface, texture);
+                }
+                else
+                {
+                    if (!ReadSurface<ColoredLayout>(i, surface))
+                    {
+                        continue;
+                    }
+
+                    albedo = GetAlbedo<ColoredLayout>(surface, texture);
+                }
+
+                batch.normal[0][lane] = surface.normal.x;
+                batch.normal[1][lane] = surface.normal.y;
+                batch.normal[2][lane] = surface.normal.z;
+                batch.position[0][lane] = surface.viewPosition.x;
+                batch.position[1][lane] = surface.viewPosition.y;
+                batch.position[2][lane] = surface.viewPosition.z;
+                batch.albedo[0][lane] = albedo.x;
+                batch.albedo[1][lane] = albedo.y;
+                batch.albedo[2][lane] = albedo.z;
+                coverage |= 1 << lane;
+            }
+
+            if (coverage == 0)
+            {
+                return;
+            }
+
+            // Normal and position have w of 0 and 1, which normalize counts in.
+            ShadingLanes normalX = LoadLanes(batch.normal[0].data());
+            ShadingLanes normalY = LoadLanes(batch.normal[1].data());
+            ShadingLanes normalZ = LoadLanes(batch.normal[2].data());
+            ShadingLanes normalScale = SetLanes(1.0f) / SqrtLanes(normalX * normalX + normalY * normalY + normalZ * normalZ);
+            normalX = normalX * normalScale;
+            normalY = normalY * normalScale;
+            normalZ = normalZ * normalScale;
+            ShadingLanes normalLength = normalX * normalX + normalY * normalY + normalZ * normalZ;
+
+            ShadingLanes positionX = LoadLanes(batch.position[0].data());
+            ShadingLanes positionY = LoadLanes(batch.position[1].data());
+            ShadingLanes positionZ = LoadLanes(batch.position[2].data());
+            ShadingLanes viewScale = SetLanes(1.0f) / SqrtLanes(positionX * positionX + positionY * positionY + positionZ * positionZ + SetLanes(1.0f));
+            ShadingLanes viewX = positionX * viewScale;
+            ShadingLanes viewY = positionY * viewScale;
+            ShadingLanes viewZ = positionZ * viewScale;
+
+            ShadingLanes zero = SetLanes(0.0f);
+            ShadingLanes lightingR = zero;
+            ShadingLanes lightingG = zero;
+            ShadingLanes lightingB = zero;
+            for (uint32_t lightIndex : tile.lights)
+            {
+                const LightS& light = Lights[lightIndex];
+                ShadingLanes lightX = SetLanes(light.position_view.x) - positionX;
+                ShadingLanes lightY = SetLanes(light.position_view.y) - positionY;
+                ShadingLanes lightZ = SetLanes(light.position_view.z) - positionZ;
+                ShadingLanes distance = lightX * lightX + lightY * lightY + lightZ * lightZ;
+
+                // Lanes the light does not reach add zero, the light is skipped only if it reaches none of them.
+                ShadingLanes attenuation = SetLanes(1.0f);
+                int32_t litLanes = coverage;
+                if (light.light.radius > 0.0f)
+                {
+                    ShadingLanes falloff = MaxLanes(SetLanes(1.0f) - distance / SetLanes(light.light.radius * light.light.radius), zero);
+                    attenuation = falloff * falloff;
+                    litLanes &= MaskBits(GreaterLanes(attenuation, zero));
+                    if (litLanes == 0)
+                    {
+                        continue;
+                    }
+                }
+
+                ShadingLanes lightScale = SetLanes(1.0f) / SqrtLanes(distance);
+                lightX = lightX * lightScale;
+                lightY = lightY * lightScale;
+                lightZ = lightZ * lightScale;
+
+                ShadingLanes diffuseAmount = MaxLanes(normalX * lightX + normalY * lightY + normalZ * lightZ, zero);
+
+                // Reflection of the direction from the light by the normal, written out like reflect does it.
+                ShadingLanes toSurfaceX = lightX * -1.0f;
+                ShadingLanes toSurfaceY = lightY * -1.0f;
+                ShadingLanes toSurfaceZ = lightZ * -1.0f;
+                ShadingLanes projection = (toSurfaceX * normalX + toSurfaceY * normalY + toSurfaceZ * normalZ) / normalLength;
+                ShadingLanes reflectedX = (toSurfaceX - normalX * projection * 2.0f) * -1.0f;
+                ShadingLanes reflectedY = (toSurfaceY - normalY * projection * 2.0f) * -1.0f;
+                ShadingLanes reflectedZ = (toSurfaceZ - normalZ * projection * 2.0f) * -1.0f;
+                ShadingLanes specAmount = MaxLanes(viewX * reflectedX + viewY * reflectedY + viewZ * reflectedZ, zero);
+
+                // Pow takes most of the time, so it is skipped, if no lit lane gets a highlight.
+                ShadingLanes specPower = zero;
+                bool hasHighlight = light.light.specularShininess == 0.0f || (MaskBits(GreaterLanes(specAmount, zero)) & litLanes) != 0;
+                if (light.light.specularStrength != 0.0f && hasHighlight)
+                {
+                    specPower = PowLanes(specAmount, light.light.specularShininess);
+                }
+
+                const Vec& color = light.light.color.GetVec();
+                lightingR = lightingR + (SetLanes(color.x) * diffuseAmount + SetLanes(color.x * light.light.ambientStrength) + SetLanes(color.x) * specPower * light.light.specularStrength) * attenuation;
+                lightingG = lightingG + (SetLanes(color.y) * diffuseAmount + SetLanes(color.y * light.light.ambientStrength) + SetLanes(color.y) * specPower * light.light.specularStrength) * attenuation;
+                lightingB = lightingB + (SetLanes(color.z) * diffuseAmount + SetLanes(color.z * light.light.ambientStrength) + SetLanes(color.z) * specPower * light.light.specularStrength) * attenuation;
+            }
+
+            alignas(32) std::array<uint32_t, ShadingLanes::Count> colors;
+            PackColorLanes(lightingR * LoadLanes(batch.albedo[0].data()), lightingG * LoadLanes(batch.albedo[1].data()), lightingB * LoadLanes(batch.albedo[2].data()), colors.data());
+            for (int32_t lane = 0; lane < count; lane++)
+            {
+                if (coverage & (1 << lane))
+                {
+                    output[(OutputHeight - 1 - fragments[lane] / OutputWidth) * OutputWidth + fragments[lane] % OutputWidth] = colors[lane];
+                }
+            }
+        }
+
+        VertexS Lerp(const VertexS& begin, const VertexS& end, float lerpAmount)
+        {
+            VertexS result;
+            result.v.position.x = Lerp(begin.v.position.x, end.v.position.x, lerpAmount);
+            result.v.position.y = Lerp(begin.v.position.y, end.v.position.y, lerpAmount);
+            result.v.position.z = Lerp(begin.v.position.z, end.v.position.z, lerpAmount);
+            result.v.position.w = Lerp(begin.v.position.w, end.v.position.w, lerpAmount);
+            result.v.textureCoord.x = Lerp(begin.v.textureCoord.x, end.v.textureCoord.x, lerpAmount);
+            result.v.textureCoord.y = Lerp(begin.v.textureCoord.y, end.v.textureCoord.y, lerpAmount);
+            result.red = Lerp(begin.red, end.red, lerpAmount);
+            result.green = Lerp(begin.green, end.green, lerpAmount);
+            result.blue = Lerp(begin.blue, end.blue, lerpAmount);
+            result.v.normal.x = Lerp(begin.v.normal.x, end.v.normal.x, lerpAmount);
+            result.v.normal.y = Lerp(begin.v.normal.y, end.v.normal.y, lerpAmount);
+            result.v.normal.z = Lerp(begin.v.normal.z, end.v.normal.z, lerpAmount);
+            result.v.normal.w = Lerp(begin.v.normal.w, end.v.normal.w, lerpAmount);
+            result.v.materialId = begin.v.materialId;
+            return result;
+        }
+
+        template<typename Attribute>
+        Interpolant GetInterpolant(const std::array<VertexS, 3>& vertices, const Attribute& c)
+        {
+            return Interpolant(
+                { vertices[0].v.position.x, vertices[0].v.position.y, c(vertices[0]) / vertices[0].v.position.w },
+                { vertices[1].v.position.x, vertices[1].v.position.y, c(vertices[1]) / vertices[1].v.position.w },
+                { vertices[2].v.position.x, vertices[2].v.position.y, c(vertices[2]) / vertices[2].v.position.w }
+            );
+        }
+
+        template<typename Layout>
+        void SetupHalfSpace(Triangle& tr)
+        {
+            HalfSpaceSetup& setup = tr.halfSpace;
+
+            // Vertices are snapped once, all the coverage decisions are made on the snapped positions.
+            std::array<int64_t, 3> xs;
+            std::array<int64_t, 3> ys;
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                xs[i] = llround(tr.vertices[i].v.position.x * SubpixelScale);
+                ys[i] = llround(tr.vertices[i].v.position.y * SubpixelScale);
+            }
+
+            // Edge function of the first edge at the third vertex, its sign tells the winding.
+            int64_t area = (xs[1] - xs[0]) * (ys[2] - ys[0]) - (ys[1] - ys[0]) * (xs[2] - xs[0]);
+            int64_t sign = area > 0 ? 1 : -1;
+
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                uint32_t begin = i;
+                uint32_t end = (i + 1) % 3;
+
+                int64_t a = -(ys[end] - ys[begin]) * sign;
+                int64_t b = (xs[end] - xs[begin]) * sign;
+
+                // Top-left fill rule: pixels exactly on an edge are covered only if it is a left edge or a horizontal top one,
+                // so the pixels on an edge shared by two triangles are covered exactly once.
+                bool isTopLeft = a > 0 || (a == 0 && b > 0);
+
+                // Function is evaluated at pixel positions, which are whole pixels in fixed point.
+                EdgeFunction& edge = setup.edges[i];
+                edge.stepX = a * SubpixelScale;
+                edge.stepY = b * SubpixelScale;
+                edge.c = -a * xs[begin] - b * ys[begin] - (isTopLeft ? 0 : 1);
+            }
+
+            if (area == 0)
+            {
+                // Degenerate triangle, interpolants are not valid for it, so it should not cover any pixel.
+                setup.edges[0] = EdgeFunction{ -1, 0, 0 };
+            }
+
+            // Bounds of the pixels, that might be covered by the snapped triangle.
+            auto [minX, maxX] = std::minmax({ xs[0], xs[1], xs[2] });
+            auto [minY, maxY] = std::minmax({ ys[0], ys[1], ys[2] });
+            tr.boundsBeginX = std::max(static_cast<int32_t>((minX + SubpixelScale - 1) >> SubpixelBits), 0);
+            tr.boundsEndX = std::min(static_cast<int32_t>(maxX >> SubpixelBits) + 1, static_cast<int32_t>(OutputWidth));
+            tr.boundsBeginY = std::max(static_cast<int32_t>((minY + SubpixelScale - 1) >> SubpixelBits), 0);
+            tr.boundsEndY = std::min(static_cast<int32_t>(maxY >> SubpixelBits) + 1, static_cast<int32_t>(OutputHeight));
+
+            const Vec& v0 = tr.vertices[0].v.position;
+            setup.z = Plane{ v0.x, v0.y, tr.interpolants[ZInterpolant].stepX, tr.interpolants[ZInterpolant].stepY, tr.interpolants[ZInterpolant].minC };
+
+            setup.originX = v0.x;
+            setup.originY = v0.y;
+            // Lanes past the layout's interpolants are zeroed, so the vectors they are loaded with stay valid numbers.
+            for (uint32_t i = 0; i < InterpolantsSize - 1; i++)
+            {
+                setup.c[i] = i < Layout::Count ? tr.interpolants[i].minC : 0.0f;
+                setup.stepX[i] = i < Layout::Count ? tr.interpolants[i].stepX : 0.0f;
+                setup.stepY[i] = i < Layout::Count ? tr.interpolants[i].stepY : 0.0f;
+            }
+        }
+
+        void AddRawTriangle(Triangle& tr, uint32_t texture)
+        {
+            tr.texture = texture;
+            if (tr.IsTextured())
+            {
+                AddRawTriangle<TexturedLayout>(tr);
+            }
+            else
+            {
+                AddRawTriangle<ColoredLayout>(tr);
+            }
+        }
+
+        template<typename Layout>
+        void AddRawTriangle(Triangle& tr)
+        {
+            for (VertexS& v : tr.vertices)
+            {
+                v.v.position.x /= v.v.position.w;
+                v.v.position.y /= v.v.position.w;
+                v.v.position.z /= v.v.position.w;
+            }
+
+            std::sort(std::begin(tr.vertices), std::end(tr.vertices), [](const VertexS& lhs, const VertexS& rhs) { return lhs.v.position.y < rhs.v.position.y; });
+
+            for (VertexS& v : tr.vertices)
+            {
+                // todo.pavelza: Clipping might result in some vertices being slightly outside of -1 to 1 range, so we clamp. Will need to think how to avoid this.
+                // With guard band vertices are expected to be outside of the screen, the rasterizer scissors them to it.
+                if (!settings.useGuardBand)
+                {
+                    v.v.position.x = std::clamp(v.v.position.x, -1.0f, 1.0f);
+                    v.v.position.y = std::clamp(v.v.position.y, -1.0f, 1.0f);
+                }
+                v.v.position.z = std::clamp(v.v.position.z, -1.0f, 1.0f);
+
+                v.v.position.x = (OutputWidth - 1) * ((v.v.position.x + 1) / 2.0f);
+                v.v.position.y = (OutputHeight - 1) * ((v.v.position.y + 1) / 2.0f);
+            }
+
+            if constexpr (Layout::HasTint)
+            {
+                tr.interpolants[Layout::Tint] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.red; });
+                tr.interpolants[Layout::Tint + 1] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.green; });
+                tr.interpolants[Layout::Tint + 2] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.blue; });
+            }
+
+            if constexpr (Layout::HasTextureCoord)
+            {
+                tr.interpolants[Layout::TextureCoord] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.textureCoord.x; });
+                tr.interpolants[Layout::TextureCoord + 1] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.textureCoord.y; });
+            }
+
+            tr.interpolants[Layout::Normal] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.x; });
+            tr.interpolants[Layout::Normal + 1] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.y; });
+            tr.interpolants[Layout::Normal + 2] = GetInterpolant(tr.vertices, [](const VertexS& v) { return v.v.normal.z; });
+
+            tr.interpolants[Layout::W] = GetInterpolant(tr.vertices, [](const VertexS& v) { return 1.0f; });
+
+            // No division by w, because it is already divided by w.
+            tr.interpolants[ZInterpolant] = Interpolant(
+                { tr.vertices[0].v.position.x, tr.vertices[0].v.position.y, tr.vertices[0].v.position.z },
+                { tr.vertices[1].v.position.x, tr.vertices[1].v.position.y, tr.vertices[1].v.position.z },
+                { tr.vertices[2].v.position.x, tr.vertices[2].v.position.y, tr.vertices[2].v.position.z });
+
+            tr.minMax = Edge(tr.vertices[0].v.position, tr.vertices[2].v.position, true);
+            tr.minMiddle = Edge(tr.vertices[0].v.position, tr.vertices[1].v.position, true);
+            tr.middleMax = Edge(tr.vertices[1].v.position, tr.vertices[2].v.position, false);
+
+            // Rows are exact, as they are the same as in the rasterization loops. Columns get a pixel of margin on each side,
+            // since span ends are calculated by stepping along the edges and might be rounded differently from the vertices.
+            // Half-space kernel replaces them with the bounds of the snapped triangle.
+            auto [minX, maxX] = std::minmax({ tr.vertices[0].v.position.x, tr.vertices[1].v.position.x, tr.vertices[2].v.position.x });
+            tr.boundsBeginX = std::max(static_cast<int32_t>(floor(minX)) - 1, 0);
+            tr.boundsEndX = std::min(static_cast<int32_t>(ceil(maxX)) + 1, static_cast<int32_t>(OutputWidth));
+            tr.boundsBeginY = std::max(tr.minMax.pixelYBegin, 0);
+            tr.boundsEndY = std::min(tr.minMax.pixelYEnd, static_cast<int32_t>(OutputHeight));
+
+            std::tie(tr.minZ, tr.maxZ) = std::minmax({ tr.vertices[0].v.position.z, tr.vertices[1].v.position.z, tr.vertices[2].v.position.z });
+
+            if (settings.rasterKernel == SceneRendererSoftware::RasterKernel::HalfSpace)
+            {
+                SetupHalfSpace<Layout>(tr);
+            }
+        }
+
+        static bool IsInside(const Vec& position, int32_t axis, int32_t plane)
+        {
+            return position.Get(axis) * plane <= position.w;
+        }
+
+        // Plane is moved out to the extent times w, which is the guard band for x and y planes, if it is used.
+        static bool IsVertexInside(const VertexS& point, int32_t axis, int32_t plane, float extent)
+        {
+            return point.v.position.Get(axis) * plane <= point.v.position.w * extent;
+        }
+
+        // todo.pavelza: There is an issue somewhere - we render black 1px line on the border sometimes when the triangle is outside of frustum (compared to dx12 renderer).
+        // And after introducing the backface culling we can sometimes see pixels from some triangles on the back in the first left 1px line.
+        // Looks like front triangle is clipped not precisely by frustum.
+        // Guard band avoids the issue, as x and y planes are moved out to it, so screen edges are always left to the rasterizer's scissoring.
+        void ClipTrianglePlane(const Polygon& polygon, Polygon& result, int32_t axis, int32_t plane, float extent)
+        {
+            const std::array<VertexS, MaxPolygonVertices>& vertices = polygon.vertices;
+            result.size = 0;
+            uint32_t previousElement = polygon.size - 1;
+
+            for (uint32_t currentElement = 0; currentElement < polygon.size; currentElement++)
+            {
+                bool isPreviousInside = IsVertexInside(vertices[previousElement], axis, plane, extent);
+                bool isCurrentInside = IsVertexInside(vertices[currentElement], axis, plane, extent);
+
+                if (isPreviousInside != isCurrentInside)
+                {
+                    float k = (vertices[previousElement].v.position.w * extent - vertices[previousElement].v.position.Get(axis) * plane);
+                    float lerpAmount = k / (k - vertices[currentElement].v.position.w * extent + vertices[currentElement].v.position.Get(axis) * plane);
+                    result.Add(Lerp(vertices[previousElement], vertices[currentElement], lerpAmount));
+                }
+
+                if (isCurrentInside)
+                {
+                    result.Add(vertices[currentElement]);
+                }
+
+                previousElement = currentElement;
+            }
+        }
+
+        // Clips against both planes of the axis, uses the second polygon as the intermediate storage.
+        bool ClipTriangleAxis(Polygon& polygon, Polygon& intermediate, int32_t axis, float extent)
+        {
+            ClipTrianglePlane(polygon, intermediate, axis, 1, extent);
+
+            if (intermediate.size == 0)
+            {
+                return false;
+            }
+
+            ClipTrianglePlane(intermediate, polygon, axis, -1, extent);
+
+            return polygon.size != 0;
+        }
+
+        void SetupModels(const Scene& scene)
+        {
+            Models.resize(scene.models.size());
+            Textures.clear();
+            Colors.clear();
+
+            for (size_t i = 0; i < Models.size(); i++)
+            {
+                const Model& model = scene.models[i];
+
+                Models[i].firstTexture = static_cast<uint32_t>(Textures.size());
+                for (const Material& material : model.materials)
+                {
+                    Load(material.textureName, Textures.emplace_back());
+                }
+
+                Models[i].firstColor = static_cast<uint32_t>(Colors.size());
+                for (const Vertex& vertex : model.vertices)
+                {
+                    Colors.push_back(vertex.color.GetVec());
+                }
+            }
+        }
+
+        // Returns true, if materials or geometry of the models changed since the previous call, and stores them for the next one.
+        bool UpdateModels(const Scene& scene)
+        {
+            bool isChanged = ModelStates.size() != scene.models.size();
+            ModelStates.resize(scene.models.size());
+
+            size_t texturesCount = 0;
+            for (size_t i = 0; i < scene.models.size(); i++)
+            {
+                const Model& model = scene.models[i];
+                ModelState& state = ModelStates[i];
+                if (state.vertices != model.vertices.data() || state.verticesCount != model.vertices.size() ||
+                    state.indices != model.indices.data() || state.indicesCount != model.indices.size() || state.version != model.version)
+                {
+                    isChanged = true;
+                    state = { model.vertices.data(), model.vertices.size(), model.indices.data(), model.indices.size(), model.version };
+                }
+
+                for (const Material& material : model.materials)
+                {
+                    if (texturesCount == TextureNames.size())
+                    {
+                        isChanged = true;
+                        TextureNames.push_back(material.textureName);
+                    }
+                    else if (TextureNames[texturesCount] != material.textureName)
+                    {
+                        isChanged = true;
+                        TextureNames[texturesCount] = material.textureName;
+                    }
+
+                    texturesCount++;
+                }
+            }
+
+            isChanged |= texturesCount != TextureNames.size();
+            TextureNames.resize(texturesCount);
+
+            return isChanged;
+        }
+
+        // Returns true, if the camera, placement of the models or instances changed since the previous call, and stores them for the next one.
+        bool UpdateView(const Scene& scene)
+        {
+            const Renderer::Camera& camera = scene.camera;
+            bool isChanged = !(Camera.position == camera.position) || Camera.pitch != camera.pitch || Camera.yaw != camera.yaw ||
+                Camera.nearPlane != camera.nearPlane || Camera.farPlane != camera.farPlane || Camera.fieldOfView != camera.fieldOfView;
+            Camera = { camera.position, camera.pitch, camera.yaw, camera.nearPlane, camera.farPlane, camera.fieldOfView };
+
+            isChanged |= ModelPlacements.size() != scene.models.size();
+            ModelPlacements.resize(scene.models.size());
+            for (size_t i = 0; i < scene.models.size(); i++)
+            {
+                const Model& model = scene.models[i];
+                isChanged |= !(ModelPlacements[i].position == model.position) || ModelPlacements[i].backfaceCulling != model.backfaceCulling;
+                ModelPlacements[i] = { model.position, model.backfaceCulling };
+            }
+
+            isChanged |= !std::equal(Instances.begin(), Instances.end(), scene.instances.begin(), scene.instances.end(), [](const Instance& lhs, const Instance& rhs) {
+                return lhs.model == rhs.model && std::equal(std::begin(lhs.transform.m), std::end(lhs.transform.m), std::begin(rhs.transform.m));
+            });
+
+            if (isChanged)
+            {
+                Instances.assign(scene.instances.begin(), scene.instances.end());
+            }
+
+            return isChanged;
+        }
+
+        // Returns true, if the lights changed since the previous call, and stores them for the next one.
+        bool UpdateLights(const std::vector<Light>& lights)
+        {
+            bool isChanged = !std::equal(LightStates.begin(), LightStates.end(), lights.begin(), lights.end(), [](const Light& lhs, const Light& rhs) {
+                return lhs.position == rhs.position && lhs.ambientStrength == rhs.ambientStrength && lhs.specularStrength == rhs.specularStrength &&
+                    lhs.specularShininess == rhs.specularShininess && lhs.color.GetVec() == rhs.color.GetVec() && lhs.radius == rhs.radius;
+            });
+
+            if (isChanged)
+            {
+                LightStates.assign(lights.begin(), lights.end());
+            }
+
+            return isChanged;
+        }
+
+        enum class FrustumTest
+        {
+            Outside,
+            Intersects,
+            Inside
+        };
+
+        // Bounds are outside, if all of their corners are outside of the same plane, in which case so are all the triangles within them.
+        static FrustumTest TestFrustum(const Bounds& bounds, const Matrix& clipTransform)
+        {
+            uint8_t outsideAll = 0xFF;
+            uint8_t outsideAny = 0;
+            for (uint32_t corner = 0; corner < 8; corner++)
+            {
+                Vec position {
+                    corner & 1 ? bounds.max.x : bounds.min.x,
+                    corner & 2 ? bounds.max.y : bounds.min.y,
+                    corner & 4 ? bounds.max.z : bounds.min.z,
+                    1.0f
+                };
+
+                uint8_t outsidePlanes = GetOutsidePlanes(clipTransform * position);
+                outsideAll &= outsidePlanes;
+                outsideAny |= outsidePlanes;
+            }
+
+            return outsideAll != 0 ? FrustumTest::Outside : outsideAny == 0 ? FrustumTest::Inside : FrustumTest::Intersects;
+        }
+
+        // Triangles of the cluster all face away, if the camera is inside of the cone mirrored behind the apex, as then it is behind all of their planes.
+        // Checked in view space, where the camera is at 0.
+        static bool IsFacingAway(const Cluster& cluster, const Matrix& modelView)
+        {
+            if (cluster.coneCutoff >= 1.0f)
+            {
+                return false;
+            }
+
+            Vec apex = modelView * cluster.coneApex;
+            apex.w = 0.0f;
+            Vec axis = normalize(modelView * cluster.coneAxis);
+
+            return dot(apex, axis) >= cluster.coneCutoff * sqrtf(dot(apex, apex));
+        }
+
+        // Bit per frustum plane, set if the position is outside of it. Plane is axis * 2 + (plane == 1 ? 0 : 1).
+        static uint8_t GetOutsidePlanes(const Vec& position)
+        {
+            uint8_t outsidePlanes = 0;
+            for (int32_t axis = 0; axis < 3; axis++)
+            {
+                outsidePlanes |= IsInside(position, axis, 1) ? 0 : 1 << (axis * 2);
+                outsidePlanes |= IsInside(position, axis, -1) ? 0 : 1 << (axis * 2 + 1);
+            }
+            return outsidePlanes;
+        }
+
+        // Vertices are transformed only in the ranges used by the visible clusters. Ranges are merged, so no vertex is transformed twice.
+        void AddCluster(uint32_t batchIndex, const Cluster& cluster)
+        {
+            uint32_t end = cluster.firstTriangle + cluster.trianglesCount;
+            for (uint32_t begin = cluster.firstTriangle; begin < end; begin += TrianglesPerChunk)
+            {
+                TriangleChunkRanges.push_back({ batchIndex, begin, std::min(begin + TrianglesPerChunk, end) });
+            }
+
+            VertexRanges.push_back({ cluster.firstVertex, cluster.firstVertex + cluster.verticesCount });
+        }
+
+        void AddVertexChunks(uint32_t batchIndex)
+        {
+            std::sort(VertexRanges.begin(), VertexRanges.end());
+            for (size_t i = 0; i < VertexRanges.size();)
+            {
+                uint32_t begin = VertexRanges[i].first;
+                uint32_t end = VertexRanges[i].second;
+                for (i++; i < VertexRanges.size() && VertexRanges[i].first <= end; i++)
+                {
+                    end = std::max(end, VertexRanges[i].second);
+                }
+
+                for (; begin < end; begin += VerticesPerChunk)
+                {
+                    VertexChunks.push_back({ batchIndex, begin, std::min(begin + VerticesPerChunk, end) });
+                }
+            }
+
+            VertexRanges.clear();
+        }
+
+        // Max depth of the blocks, that the bounds cover on the screen, is taken from the pyramid level, where they cover at most 2x2 texels.
+        // Bounds are occluded, if their closest point is behind it.
+        bool IsOccluded(const Bounds& bounds, const Matrix& clipTransform) const
+        {
+            float minX = std::numeric_limits<float>::max();
+            float maxX = std::numeric_limits<float>::lowest();
+            float minY = std::numeric_limits<float>::max();
+            float maxY = std::numeric_limits<float>::lowest();
+            float minZ = std::numeric_limits<float>::max();
+            for (uint32_t corner = 0; corner < 8; corner++)
+            {
+                Vec position = clipTransform * Vec {
+                    corner & 1 ? bounds.max.x : bounds.min.x,
+                    corner & 2 ? bounds.max.y : bounds.min.y,
+                    corner & 4 ? bounds.max.z : bounds.min.z,
+                    1.0f
+                };
+
+                // Bounds crossing the near plane can not be projected, they are close enough to be drawn anyway.
+                if (position.z < 0.0f || position.w <= 0.0f)
+                {
+                    return false;
+                }
+
+                minX = std::min(minX, position.x / position.w);
+                maxX = std::max(maxX, position.x / position.w);
+                minY = std::min(minY, position.y / position.w);
+                maxY = std::max(maxY, position.y / position.w);
+                minZ = std::min(minZ, position.z / position.w);
+            }
+
+            // Pixels the same way as for triangles, with a pixel of margin.
+            int32_t xBegin = std::max(static_cast<int32_t>(floor((OutputWidth - 1) * (minX + 1) / 2.0f)) - 1, 0);
+            int32_t xEnd = std::min(static_cast<int32_t>(ceil((OutputWidth - 1) * (maxX + 1) / 2.0f)) + 1, static_cast<int32_t>(OutputWidth) - 1);
+            int32_t yBegin = std::max(static_cast<int32_t>(floor((OutputHeight - 1) * (minY + 1) / 2.0f)) - 1, 0);
+            int32_t yEnd = std::min(static_cast<int32_t>(ceil((OutputHeight - 1) * (maxY + 1) / 2.0f)) + 1, static_cast<int32_t>(OutputHeight) - 1);
+            if (xBegin > xEnd || yBegin > yEnd)
+            {
+                return false;
+            }
+
+            int32_t blockXBegin = xBegin / BlockSize;
+            int32_t blockXEnd = xEnd / BlockSize;
+            int32_t blockYBegin = yBegin / BlockSize;
+            int32_t blockYEnd = yEnd / BlockSize;
+
+            size_t levelIndex = 0;
+            while (levelIndex + 1 < DepthPyramidLevels.size() &&
+                ((blockXEnd >> levelIndex) - (blockXBegin >> levelIndex) > 1 || (blockYEnd >> levelIndex) - (blockYBegin >> levelIndex) > 1))
+            {
+                levelIndex++;
+            }
+
+            const DepthPyramidLevel& level = DepthPyramidLevels[levelIndex];
+            float maxZ = std::numeric_limits<float>::lowest();
+            for (int32_t y = blockYBegin >> levelIndex; y <= blockYEnd >> levelIndex; y++)
+            {
+                for (int32_t x = blockXBegin >> levelIndex; x <= blockXEnd >> levelIndex; x++)
+                {
+                    maxZ = std::max(maxZ, DepthPyramid[level.offset + y * level.width + x]);
+                }
+            }
+
+            return minZ - HiZEpsilon > maxZ;
+        }
+
+        // Level 0 is max z of hierarchical z blocks. Stored max z of a block is never lower than the depth in it, so the pyramid is conservative.
+        // Blocks of tiles, that were not rasterized, are empty.
+        void BuildDepthPyramid()
+        {
+            DepthPyramidLevels.clear();
+
+            size_t width = HiZWidth;
+            size_t height = HiZHeight;
+            size_t size = 0;
+            while (true)
+            {
+                DepthPyramidLevels.push_back({ size, width, height });
+                size += width * height;
+                if (width == 1 && height == 1)
+                {
+                    break;
+                }
+
+                width = (width + 1) / 2;
+                height = (height + 1) / 2;
+            }
+
+            DepthPyramid.resize(size);
+
+            for (size_t y = 0; y < HiZHeight; y++)
+            {
+                for (size_t x = 0; x < HiZWidth; x++)
+                {
+                    DepthPyramid[y * HiZWidth + x] = GetTile(x * BlockSize, y * BlockSize).isCleared ? HiZMax[y * HiZWidth + x] : ClearDepth;
+                }
+            }
+
+            for (size_t i = 1; i < DepthPyramidLevels.size(); i++)
+            {
+                const DepthPyramidLevel& source = DepthPyramidLevels[i - 1];
+                const DepthPyramidLevel& level = DepthPyramidLevels[i];
+                for (size_t y = 0; y < level.height; y++)
+                {
+                    for (size_t x = 0; x < level.width; x++)
+                    {
+                        size_t sourceX = std::min(x * 2 + 1, source.width - 1);
+                        size_t sourceY = std::min(y * 2 + 1, source.height - 1);
+                        DepthPyramid[level.offset + y * level.width + x] = std::max({
+                            DepthPyramid[source.offset + y * 2 * source.width + x * 2],
+                            DepthPyramid[source.offset + y * 2 * source.width + sourceX],
+                            DepthPyramid[source.offset + sourceY * source.width + x * 2],
+                            DepthPyramid[source.offset + sourceY * source.width + sourceX]
+                        });
+                    }
+                }
+            }
+        }
+
+        // Clusters rejected by the pyramid of the previous frame are tested again against the one of the current frame. Those, that are
+        // not hidden by what is drawn already, are added for another pass of the pipeline, so objects, that got visible, do not pop in a frame late.
+        void SetupRevealedClusters()
+        {
+            VertexChunks.clear();
+
+            for (size_t i = 0; i < OccludedClusters.size(); i++)
+            {
+                const OccludedCluster& occluded = OccludedClusters[i];
+                if (IsOccluded(occluded.cluster->bounds, Batches[occluded.batch].clipTransform))
+                {
+                    OccludedTriangles += occluded.cluster->trianglesCount;
+                }
+                else
+                {
+                    AddCluster(occluded.batch, *occluded.cluster);
+                }
+
+                if (i + 1 == OccludedClusters.size() || OccludedClusters[i + 1].batch != occluded.batch)
+                {
+                    AddVertexChunks(occluded.batch);
+                }
+            }
+        }
+
+        void RasterizeTiles()
+        {
+            std::for_each(std::execution::par, Tiles.begin(), Tiles.end(), [this](Tile& tile) {
+                // Tiles without triangles in the pass keep the fragments of the previous pass of the frame.
+                if (!tile.triangles.empty())
+                {
+                    RasterizeTile(tile);
+                    CompactFragments(tile);
+                }
+            });
+        }
+
+        // Depth of the tile is still in the cache of the thread, that rasterized it, so it is compared to the clear depth 4 pixels at once.
+        void CompactFragments(Tile& tile)
+        {
+            tile.fragments.clear();
+
+            __m128 clearDepth = _mm_set1_ps(ClearDepth);
+            for (int32_t y = tile.beginY; y < tile.endY; y++)
+            {
+                uint32_t rowBegin = static_cast<uint32_t>(y * OutputWidth);
+                int32_t x = tile.beginX;
+                for (; x + SimdWidth <= tile.endX; x += SimdWidth)
+                {
+                    uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(&ZBuffer[rowBegin + x]), clearDepth)));
+                    for (; mask != 0; mask &= mask - 1)
+                    {
+                        tile.fragments.push_back(rowBegin + x + std::countr_zero(mask));
+                    }
+                }
+
+                for (; x < tile.endX; x++)
+                {
+                    if (ZBuffer[rowBegin + x] != ClearDepth)
+                    {
+                        tile.fragments.push_back(rowBegin + x);
+                    }
+                }
+            }
+        }
+
+        // Lays out transformed vertices of all drawn instances one after another and splits their geometry into chunks.
+        void SetupBatches(const Scene& scene, const Matrix& view)
+        {
+            Projection = PerspectiveTransform(scene.camera, static_cast<float>(OutputWidth), static_cast<float>(OutputHeight));
+
+            Batches.clear();
+            VertexChunks.clear();
+            TriangleChunkRanges.clear();
+
+            OccludedClusters.clear();
+            CulledTriangles = 0;
+            ConeCulledTriangles = 0;
+            OccludedTriangles = 0;
+
+            // Depth pyramid of the previous frame is only usable, if it was built for the same screen.
+            TestOcclusion = settings.useOcclusionCulling && settings.useHierarchicalZ &&
+                !DepthPyramidLevels.empty() && DepthPyramidLevels[0].width == HiZWidth && DepthPyramidLevels[0].height == HiZHeight;
+
+            uint32_t verticesCount = 0;
+            auto addBatch = [this, &scene, &view, &verticesCount](uint32_t modelIndex, const Matrix& transform) {
+                const Model& model = scene.models[modelIndex];
+                Matrix modelView = view * transform;
+                Matrix clipTransform = Projection * modelView;
+
+                // Models without clusters are drawn as a whole.
+                FrustumTest modelTest = settings.useFrustumCulling && !model.clusters.empty() ? TestFrustum(model.bounds, clipTransform) : FrustumTest::Inside;
+                if (modelTest == FrustumTest::Outside)
+                {
+                    CulledTriangles += model.indices.size() / 3;
+                    return;
+                }
+
+                uint32_t batchIndex = static_cast<uint32_t>(Batches.size());
+                ModelBatch& batch = Batches.emplace_back();
+                batch.model = &model;
+                batch.resources = &Models[modelIndex];
+                batch.transform = modelView;
+                batch.clipTransform = clipTransform;
+                batch.firstVertex = verticesCount;
+                verticesCount += static_cast<uint32_t>(model.vertices.size());
+
+                bool useConeCulling = settings.useConeCulling && model.backfaceCulling && !model.clusters.empty();
+                bool useOcclusionCulling = TestOcclusion && !model.clusters.empty();
+                if (modelTest == FrustumTest::Inside && !useConeCulling && !useOcclusionCulling)
+                {
+                    Cluster wholeModel;
+                    wholeModel.trianglesCount = static_cast<uint32_t>(model.indices.size() / 3);
+                    wholeModel.verticesCount = static_cast<uint32_t>(model.vertices.size());
+                    AddCluster(batchIndex, wholeModel);
+                }
+                else
+                {
+                    for (const Cluster& cluster : model.clusters)
+                    {
+                        if (modelTest == FrustumTest::Intersects && TestFrustum(cluster.bounds, clipTransform) == FrustumTest::Outside)
+                        {
+                            CulledTriangles += cluster.trianglesCount;
+                        }
+                        else if (useConeCulling && IsFacingAway(cluster, modelView))
+                        {
+                            ConeCulledTriangles += cluster.trianglesCount;
+                        }
+                        else if (useOcclusionCulling && IsOccluded(cluster.bounds, clipTransform))
+                        {
+                            OccludedClusters.push_back({ batchIndex, &cluster });
+                        }
+                        else
+                        {
+                            AddCluster(batchIndex, cluster);
+                        }
+                    }
+                }
+
+                AddVertexChunks(batchIndex);
+            };
+
+            if (scene.instances.empty())
+            {
+                for (uint32_t i = 0; i < scene.models.size(); i++)
+                {
+                    addBatch(i, ModelTransform(scene.models[i]));
+                }
+            }
+            else
+            {
+                for (const Instance& instance : scene.instances)
+                {
+                    addBatch(instance.model, instance.transform);
+                }
+            }
+
+            Vertices.positions.resize(verticesCount);
+            Vertices.normals.resize(verticesCount);
+            Vertices.outsidePlanes.resize(verticesCount);
+            Vertices.outsideGuardBand.resize(verticesCount);
+        }
+
+        void TransformVertices()
+        {
+            std::for_each(std::execution::par, VertexChunks.begin(), VertexChunks.end(), [this](const GeometryChunk& chunk) {
+                const ModelBatch& batch = Batches[chunk.batch];
+
+                for (uint32_t vertexIndex = chunk.begin; vertexIndex < chunk.end; vertexIndex++)
+                {
+                    const Vertex& vertex = batch.model->vertices[vertexIndex];
+                    size_t i = batch.firstVertex + vertexIndex;
+
+                    Vertices.positions[i] = batch.clipTransform * vertex.position;
+                    // This is possible because we do not do non-uniform scale in transform. If we are about to do non-uniform scale, we should calculate the normal matrix.
+                    Vertices.normals[i] = batch.transform * vertex.normal;
+
+                    Vertices.outsidePlanes[i] = GetOutsidePlanes(Vertices.positions[i]);
+
+                    uint8_t outsideGuardBand = 0;
+                    for (int32_t axis = 0; axis < 2; axis++)
+                    {
+                        float guardBand = GuardBand * Vertices.positions[i].w;
+                        outsideGuardBand |= Vertices.positions[i].Get(axis) <= guardBand ? 0 : 1 << (axis * 2);
+                        outsideGuardBand |= -Vertices.positions[i].Get(axis) <= guardBand ? 0 : 1 << (axis * 2 + 1);
+                    }
+                    Vertices.outsideGuardBand[i] = outsideGuardBand;
+                }
+            });
+        }
+
+        // Index is the one in the frame's vertex arrays.
+        VertexS GetTransformedVertex(const ModelBatch& batch, uint32_t index) const
+        {
+            uint32_t vertexIndex = index - batch.firstVertex;
+            const Vec& color = Colors[batch.resources->firstColor + vertexIndex];
+
+            VertexS result{ batch.model->vertices[vertexIndex], color.x, color.y, color.z };
+            result.v.position = Vertices.positions[index];
+            result.v.normal = Vertices.normals[index];
+            return result;
+        }
+
+        // Chunks before the first one are kept, as triangles of the first pass are still referenced in the second one.
+        void AddTriangles(size_t firstChunk)
+        {
+            TriangleChunks.resize(TriangleChunkRanges.size());
+
+            auto r = std::ranges::iota_view<size_t, size_t>{ firstChunk, TriangleChunkRanges.size() };
+            std::for_each(std::execution::par, r.begin(), r.end(), [this](size_t chunkIndex) {
+                const GeometryChunk& chunk = TriangleChunkRanges[chunkIndex];
+                std::vector<Triangle>& triangles = TriangleChunks[chunkIndex];
+                triangles.clear();
+
+                for (uint32_t i = chunk.begin; i < chunk.end; i++)
+                {
+                    AddTriangle(Batches[chunk.batch], i, triangles);
+                }
+            });
+        }
+
+        void AddTriangle(const ModelBatch& batch, uint32_t index, std::vector<Triangle>& triangles)
+        {
+            const Model& model = *batch.model;
+            std::array<uint32_t, 3> indices { model.indices[index * 3 + 0], model.indices[index * 3 + 1], model.indices[index * 3 + 2] };
+
+            int32_t materialId = model.vertices[indices[0]].materialId;
+            uint32_t texture = materialId < 0 ? NoTexture : batch.resources->firstTexture + materialId;
+
+            for (uint32_t& i : indices)
+            {
+                i += batch.firstVertex;
+            }
+
+            const Vec& p0 = Vertices.positions[indices[0]];
+            const Vec& p1 = Vertices.positions[indices[1]];
+            const Vec& p2 = Vertices.positions[indices[2]];
+
+            // Backface culling produces very rough results in view space (maybe need to figure out why some day). So we do it in clip space. And it seems to be the right (identical to hardware) way.
+            // Doing clipspace culling before we split triangles that penetrate camera frustum gives us additional ~10ms gain for a frame in reference scene.
+            // Front is counter clockwise.
+            Vec v0 { p0.x / p0.w, p0.y / p0.w, p0.z / p0.w, 1.0f };
+            Vec v1 { p1.x / p1.w, p1.y / p1.w, p1.z / p1.w, 1.0f };
+            Vec v2 { p2.x / p2.w, p2.y / p2.w, p2.z / p2.w, 1.0f };
+            if (model.backfaceCulling && cross(v2 - v0, v1 - v0).z > 0)
+            {
+                return;
+            }
+
+            // We must check that all triangle lies on outside of one of the planes,
+            // since if we check that some vertices lie on the outside of one plane and others on outside of the other,
+            // then part of the triangle might still be visible.
+            // This check doesn't give us a big performance boost in a general case,
+            // but it doesn't seem to hit performance in general case too much to remove it either.
+            uint8_t outside0 = Vertices.outsidePlanes[indices[0]];
+            uint8_t outside1 = Vertices.outsidePlanes[indices[1]];
+            uint8_t outside2 = Vertices.outsidePlanes[indices[2]];
+            if ((outside0 & outside1 & outside2) != 0)
+            {
+                return;
+            }
+
+            // With guard band only near and far planes have to be clipped, unless the triangle goes out of the guard band.
+            bool isClippedByXY = (outside0 | outside1 | outside2) & ~ZPlanes;
+            if (settings.useGuardBand)
+            {
+                isClippedByXY = (Vertices.outsideGuardBand[indices[0]] | Vertices.outsideGuardBand[indices[1]] | Vertices.outsideGuardBand[indices[2]]) != 0;
+            }
+            bool isClippedByZ = (outside0 | outside1 | outside2) & ZPlanes;
+
+            // Vertices are copied only for the triangles that survived culling, as clipping and setup need them by value.
+            // Triangles are set up in place, so the output storage, which is kept between frames, is the only one they need.
+            if (!isClippedByXY && !isClippedByZ)
+            {
+                Triangle& tr = triangles.emplace_back();
+                for (uint32_t i = 0; i < 3; i++)
+                {
+                    tr.vertices[i] = GetTransformedVertex(batch, indices[i]);
+                }
+
+                AddRawTriangle(tr, texture);
+                return;
+            }
+
+            Polygon polygon;
+            Polygon intermediate;
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                polygon.Add(GetTransformedVertex(batch, indices[i]));
+            }
+
+            // Triangles, that go out of the guard band, are clipped by its planes, so the screen edges are still scissored.
+            float extentXY = settings.useGuardBand ? GuardBand : 1.0f;
+            if ((!isClippedByXY || (ClipTriangleAxis(polygon, intermediate, 0, extentXY) && ClipTriangleAxis(polygon, intermediate, 1, extentXY))) &&
+                (!isClippedByZ || ClipTriangleAxis(polygon, intermediate, 2, 1.0f)))
+            {
+                assert(polygon.size >= 3);
+
+                for (uint32_t i = 2; i < polygon.size; i++)
+                {
+                    Triangle& tr = triangles.emplace_back();
+                    tr.vertices = { polygon.vertices[0], polygon.vertices[i - 1], polygon.vertices[i] };
+
+                    AddRawTriangle(tr, texture);
+                }
+            }
+        }
+    };
+
+    bool SceneRendererSoftware::Render(const Scene& scene, Texture& texture)
+    {
+        if (texture.GetWidth() == 0 || texture.GetHeight() == 0)
+        {
+            return false;
+        }
+
+        if (std::any_of(scene.instances.begin(), scene.instances.end(), [&scene](const Instance& instance) { return instance.model >= scene.models.size(); }))
+        {
+            return false;
+        }
+
+        if (context == nullptr || context->scene.name != scene.name)
+        {
+            context = std::make_shared<SceneRendererSoftwareContext>(scene);
+        }
+
+        auto frameBegin = std::chrono::steady_clock::now();
+
+        // Scale is picked after each rendered frame for the next one.
+        float resolutionScale = settings.targetFrameTime > 0.0f ? context->ResolutionScale : 1.0f;
+        size_t width = std::max<size_t>(static_cast<size_t>(texture.GetWidth() * resolutionScale + 0.5f), 1);
+        size_t height = std::max<size_t>(static_cast<size_t>(texture.GetHeight() * resolutionScale + 0.5f), 1);
+
+        // Every input is compared, so all of them are stored for the next frame.
+        bool isModelsChanged = context->UpdateModels(scene);
+        bool isViewChanged = context->UpdateView(scene);
+        bool isLightChanged = context->UpdateLights(scene.lights);
+        isViewChanged |= isModelsChanged || !(context->settings == settings) ||
+            context->TextureWidth != texture.GetWidth() || context->TextureHeight != texture.GetHeight() ||
+            context->OutputWidth != width || context->OutputHeight != height;
+
+        bool isTextureChanged = context->TextureBuffer != texture.GetBuffer() ||
+            context->TextureFirstPixel != *reinterpret_cast<const uint32_t*>(texture.GetBuffer());
+
+        // Texture already holds the frame, other statistics are kept from the frames, that ran the stages.
+        if (!isViewChanged && !isLightChanged && !isTextureChanged)
+        {
+            statistics.frameUpdate = FrameUpdate::None;
+            return true;
+        }
+
+        size_t buffersCapacity = context->GetBuffersCapacity();
+        float fixedTime = 0.0f;
+
+        // Frame is shaded to the output directly at full resolution.
+        bool isScaled = width != texture.GetWidth() || height != texture.GetHeight();
+        if (isScaled && (context->ScaledTexture.GetWidth() != width || context->ScaledTexture.GetHeight() != height))
+        {
+            context->ScaledTexture = Texture(width, height);
+        }
+
+        Texture& target = isScaled ? context->ScaledTexture : texture;
+
+        // Buffers of the previous frame are still valid, if only the lights changed, so they are just shaded again.
+        if (isViewChanged)
+        {
+            context->settings = settings;
+            statistics = Statistics{};
+            statistics.resolutionScale = resolutionScale;
+            context->OutputWidth = width;
+            context->OutputHeight = height;
+            context->TextureWidth = texture.GetWidth();
+            context->TextureHeight = texture.GetHeight();
+
+            // Buffers are cleared per tile while rasterizing.
+            PERF_START("Resize buffers");
+            context->ZBuffer.resize(context->OutputWidth * context->OutputHeight);
+
+            if (settings.useVisibilityBuffer)
+            {
+                context->IdBuffer.resize(context->OutputWidth * context->OutputHeight);
+            }
+            else
+            {
+                context->ResizeGBuffer(context->OutputWidth * context->OutputHeight);
+                context->TBuffer.resize(context->OutputWidth * context->OutputHeight);
+            }
+
+            context->HiZWidth = (context->OutputWidth + SceneRendererSoftwareContext::BlockSize - 1) / SceneRendererSoftwareContext::BlockSize;
+            context->HiZHeight = (context->OutputHeight + SceneRendererSoftwareContext::BlockSize - 1) / SceneRendererSoftwareContext::BlockSize;
+            context->HiZMin.resize(context->HiZWidth * context->HiZHeight);
+            context->HiZMax.resize(context->HiZWidth * context->HiZHeight);
+            PERF_END();
+
+            PERF_START("Materials");
+            if (isModelsChanged)
+            {
+                context->SetupModels(scene);
+            }
+            PERF_END();
+
+            PERF_START("Transform vertices");
+            context->SetupBatches(scene, ViewTransform(scene.camera));
+            context->TransformVertices();
+            statistics.culledTriangles = context->CulledTriangles;
+            statistics.coneCulledTriangles = context->ConeCulledTriangles;
+            PERF_END();
+
+            PERF_START("Add triangles");
+            context->AddTriangles(0);
+            PERF_END();
+
+            fixedTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameBegin).count();
+
+            PERF_START("Binning");
+            context->SetupTiles();
+            context->BinTriangles(0);
+            PERF_END();
+
+            PERF_START("Rasterization");
+            context->RasterizeTiles();
+            PERF_END();
+
+            PERF_START("Occlusion culling");
+            if (settings.useOcclusionCulling && settings.useHierarchicalZ)
+            {
+                context->BuildDepthPyramid();
+            }
+            else
+            {
+                context->DepthPyramidLevels.clear();
+            }
+
+            if (!context->OccludedClusters.empty())
+            {
+                size_t firstChunk = context->TriangleChunkRanges.size();
+                context->SetupRevealedClusters();
+                context->TransformVertices();
+                context->AddTriangles(firstChunk);
+                context->BinTriangles(firstChunk);
+                context->RasterizeTiles();
+            }
+
+            statistics.occludedTriangles = context->OccludedTriangles;
+
+            for (const Tile& tile : context->Tiles)
+            {
+                statistics.hiZTestedBlocks += tile.hiZTestedBlocks;
+                statistics.hiZRejectedBlocks += tile.hiZRejectedBlocks;
+                statistics.depthWrittenPixels += tile.depthWrittenPixels;
+                statistics.coveredPixels += tile.coveredPixels;
+            }
+            PERF_END();
+        }
+
+        statistics.frameUpdate = isViewChanged ? FrameUpdate::Full : FrameUpdate::Shading;
+
+        PERF_START("Light transform");
+        // calculate lights' positions in view space
+        context->Lights.resize(scene.lights.size());
+        for (size_t i = 0; i < scene.lights.size(); i++)
+        {
+            context->Lights[i].position_view = ViewTransform(scene.camera) * scene.lights[i].position;
+            context->Lights[i].light = scene.lights[i];
         }
         PERF_END();
 
-        PERF_START("GBuffer");
-        std::for_each(std::execution::par, trianglesCache.begin(), trianglesCache.end(), [this](Triangle& tr) { context->FillGBuffer(tr); });
+        PERF_START("Light culling");
+        context->CullLights();
+        statistics.tileLights = 0;
+        for (const Tile& tile : context->Tiles)
+        {
+            statistics.tileLights += tile.lights.size();
+        }
         PERF_END();
 
         PERF_START("Shading");
-        context->ShadePixels();
+        context->ShadePixels(target);
         PERF_END();
 
-        PERF_START("Buffer to texture");
-        for (size_t i = 0; i < context->BackBuffer.size(); i++)
+        auto upsamplingBegin = std::chrono::steady_clock::now();
+        if (isScaled)
         {
-            texture.SetColor(i, Color(context->BackBuffer[i]));
+            PERF_START("Upsampling");
+            SceneRendererSoftwareContext::Upsample(target, texture);
+            PERF_END();
         }
-        PERF_END();
+
+        context->TextureBuffer = texture.GetBuffer();
+        context->TextureFirstPixel = *reinterpret_cast<const uint32_t*>(texture.GetBuffer());
+
+        // Frames, that are only shaded, do not tell the time of the stages before shading.
+        if (isViewChanged)
+        {
+            auto frameEnd = std::chrono::steady_clock::now();
+            fixedTime += std::chrono::duration<float, std::milli>(frameEnd - upsamplingBegin).count();
+            context->UpdateResolutionScale(fixedTime, std::chrono::duration<float, std::milli>(frameEnd - frameBegin).count());
+        }
+
+        statistics.buffersGrowthBytes = context->GetBuffersCapacity() - buffersCapacity;
 
         return true;
     }
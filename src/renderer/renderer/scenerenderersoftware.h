@@ -8,9 +8,109 @@ namespace Renderer
 
     struct SceneRendererSoftware : public SceneRenderer
     {
+        enum class RasterKernel
+        {
+            Scanline, // Walks triangle spans between edges pixel by pixel.
+            HalfSpace // Tests 8x8 pixel blocks against fixed point edge functions with SIMD.
+        };
+
+        enum class ShadingKernel
+        {
+            Scalar, // Shades pixels one by one.
+            Simd // Lights rows of 8 pixels at once with AVX2 or, if the build does not target it, SSE. Approximates pow of specular highlights.
+        };
+
+        // Layouts of a G buffer pixel. Pixels, that are not covered, are told by the depth buffer, so G buffers are not cleared.
+        enum class GBufferLayout
+        {
+            Explicit, // Raw interpolants as 9 floats, 36 bytes.
+            Packed, // Octahedral normal, 16 bit texture coordinates, RGB8 tint and half float view position, 20 bytes.
+            PackedDepth // Same as packed, but without view position, which is reconstructed from depth like for the other layouts, 12 bytes.
+        };
+
+        struct Settings
+        {
+            RasterKernel rasterKernel = RasterKernel::Scanline;
+            // Rejects 8x8 pixel blocks of triangles, that are fully behind the depth already stored for the block.
+            bool useHierarchicalZ = true;
+            // Clips triangles only by near and far planes, parts outside of the screen are skipped while rasterizing.
+            bool useGuardBand = true;
+            // Rasterizes only depth and triangle id per pixel, attributes are interpolated for the visible triangle while shading.
+            bool useVisibilityBuffer = false;
+            // Writes attributes in the depth pass instead of rasterizing triangles again, triangles are sorted front to back to overwrite less.
+            // Ignored in visibility buffer mode, which is single pass already.
+            bool useSinglePass = false;
+            // Rejects models and their clusters of triangles outside of the camera frustum by their bounds, before their vertices are transformed.
+            bool useFrustumCulling = true;
+            // Rejects clusters of triangles, that all face away from the camera, by their normal cones, before their vertices are transformed.
+            bool useConeCulling = true;
+            // Rejects clusters of triangles behind the depth of the previous frame. Rejected clusters are tested again against the depth
+            // of the visible ones and drawn in a second pass, if they are not hidden by it. Needs hierarchical z, whose blocks the depth is kept for.
+            bool useOcclusionCulling = true;
+            // Milliseconds a frame should take. If above zero, frames are rendered at a lower resolution, that is picked from the timings
+            // of the previous frames to hold it, and upsampled to the texture. Resolution is scaled down to the min scale at most.
+            float targetFrameTime = 0.0f;
+            float minResolutionScale = 0.25f;
+            // Shades pixels only by the lights, that reach the depth range of the pixels' tile. Lights without radius reach every tile.
+            bool useLightCulling = true;
+            ShadingKernel shadingKernel = ShadingKernel::Simd;
+            GBufferLayout gBufferLayout = GBufferLayout::Explicit;
+
+            bool operator==(const Settings&) const = default;
+        };
+
+        // Stages of the renderer, that ran in the frame. Scene and settings are compared to the ones of the previous frame,
+        // so only the stages, that changes affect, run again.
+        enum class FrameUpdate
+        {
+            Full, // Camera, models, instances, settings or the texture size changed, the frame is rendered from scratch.
+            Shading, // Only the lights or the texture changed, buffers of the previous frame are shaded again.
+            None // Nothing changed and the texture is the one the previous frame was rendered to, it is left as is.
+        };
+
+        struct Statistics
+        {
+            // Counters below are kept from the last frame, that ran the stages they count. Frames without any update keep all of them.
+            FrameUpdate frameUpdate = FrameUpdate::Full;
+
+            // Size of the rendered frame relative to the texture in both directions.
+            float resolutionScale = 1.0f;
+
+            // Blocks of 8x8 pixels, that triangles overlap, tested against hierarchical z in both depth and attribute passes.
+            uint64_t hiZTestedBlocks = 0;
+            uint64_t hiZRejectedBlocks = 0;
+
+            // Pixels, that passed the depth test, and pixels covered by any triangle. Their ratio is the overdraw of the depth pass,
+            // which in single pass mode is the number of times attributes are written per pixel.
+            uint64_t depthWrittenPixels = 0;
+            uint64_t coveredPixels = 0;
+
+            // Triangles of the models and clusters rejected by frustum culling and of the clusters rejected by cone culling.
+            uint64_t culledTriangles = 0;
+            uint64_t coneCulledTriangles = 0;
+            // Triangles of the clusters hidden both by the depth of the previous frame and by the depth of the first pass.
+            uint64_t occludedTriangles = 0;
+
+            // Lights in the lists of all tiles, each pixel is shaded by the lights of its tile. Without light culling it is
+            // the number of lights times the number of tiles with triangles.
+            uint64_t tileLights = 0;
+
+            // Bytes the renderer's buffers had to grow by during the last rendered or shaded frame. Buffers are kept between frames,
+            // so it is zero once the renderer has seen the scene.
+            uint64_t buffersGrowthBytes = 0;
+        };
+
+        // Returns false without rendering, if the texture is empty or an instance refers to a model, that the scene does not have.
         bool Render(const Scene& scene, Texture& texture) override;
 
+        // Is read on every Render call, so can be changed between frames.
+        Settings settings;
+
+        // Statistics of the last rendered frame.
+        const Statistics& GetStatistics() const { return statistics; }
+
     private:
         std::shared_ptr<SceneRendererSoftwareContext> context;
+        Statistics statistics;
     };
-}
\ No newline at end of file
+}
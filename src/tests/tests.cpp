@@ -179,6 +179,32 @@ namespace Tests
             Assert::IsTrue(secondModel.materials[0].name == "quad_material_0");
             Assert::IsTrue(secondModel.materials[1].textureName == (QuadsDir + "quad_1.png"));
             Assert::IsTrue(secondModel.materials[1].name == "quad_material_1");
+
+            // bounds are calculated for loaded models
+            Assert::IsTrue(Renderer::Vec{ -0.5, -0.5, 0.0, 1.0 } == secondModel.bounds.min);
+            Assert::IsTrue(Renderer::Vec{ 0.5, 0.5, 0.0, 1.0 } == secondModel.bounds.max);
+            Assert::AreEqual(size_t(1), secondModel.clusters.size());
+            Assert::AreEqual(uint32_t(0), secondModel.clusters[0].firstTriangle);
+            Assert::AreEqual(uint32_t(2), secondModel.clusters[0].trianglesCount);
+            Assert::AreEqual(uint32_t(0), secondModel.clusters[0].firstVertex);
+            Assert::AreEqual(uint32_t(6), secondModel.clusters[0].verticesCount);
+
+            // light is correctly loaded with its optional radius
+            Assert::AreEqual(size_t(1), scene.lights.size());
+            Assert::IsTrue(Renderer::Vec{ 1.0, 2.0, 3.0, 1.0 } == scene.lights[0].position);
+            Assert::AreEqual(0.1f, scene.lights[0].ambientStrength);
+            Assert::AreEqual(0.5f, scene.lights[0].specularStrength);
+            Assert::AreEqual(32.0f, scene.lights[0].specularShininess);
+            Assert::AreEqual(3.5f, scene.lights[0].radius);
+        }
+
+        TEST_METHOD(LoadShouldLeaveLightRadiusZeroWhenLightFileHasNoRadius)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(TriangleDir + "scene.sce", scene));
+
+            Assert::AreEqual(size_t(1), scene.lights.size());
+            Assert::AreEqual(0.0f, scene.lights[0].radius);
         }
 
         TEST_METHOD(LoadShouldFailWhenThereIsNoSceneFile)
@@ -345,6 +371,502 @@ namespace Tests
             RenderAndCompareToReference(renderer, scene, "triangle_software");
         }
 
+        TEST_METHOD(RenderShouldUseBackfaceCullingFlagProperly)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            scene.camera.position = {0.0f, 2.3f, 5.0f, 1.0f };
+            scene.camera.pitch = 0.7f;
+
+            RenderAndCompareToReference(renderer, scene, "backface_0_software");
+
+            scene.camera.position = {0.0f, -5.0f, 5.0f, 1.0f };
+            scene.camera.pitch = 5.69f;
+
+            RenderAndCompareToReference(renderer, scene, "backface_1_software");
+        }
+
+        TEST_METHOD(RenderShouldDrawInstancesInsteadOfModels)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            for (uint32_t i = 0; i < scene.models.size(); i++)
+            {
+                scene.instances.push_back({ i, Renderer::ModelTransform(scene.models[i]) });
+            }
+
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderInstancesOfTheSameModel)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            scene.camera.position = { 0.0f, 4.0f, 14.0f, 1.0f };
+            scene.camera.pitch = 0.3f;
+
+            scene.instances.push_back({ 1, Renderer::ModelTransform(scene.models[1]) });
+            for (int32_t i = 0; i < 3; i++)
+            {
+                for (int32_t j = 0; j < 2; j++)
+                {
+                    scene.instances.push_back({ 0, Renderer::translate(-4.0f + 4.0f * i, 0.0f, -5.0f * j) * Renderer::rotateY(0.5f * i) });
+                }
+            }
+
+            RenderAndCompareToReference(renderer, scene, "instances_software");
+        }
+
+        TEST_METHOD(RenderShouldReturnFalseIfInstanceRefersToMissingModel)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            uint32_t missingModel = static_cast<uint32_t>(scene.models.size());
+            scene.instances.push_back({ 0, Renderer::ModelTransform(scene.models[0]) });
+            scene.instances.push_back({ missingModel, Renderer::ModelTransform(scene.models[0]) });
+
+            Renderer::Texture texture(200, 150);
+            Assert::IsFalse(renderer.Render(scene, texture));
+
+            scene.instances.pop_back();
+            Assert::IsTrue(renderer.Render(scene, texture));
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderSimpleSceneWithHalfSpaceKernel)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.rasterKernel = Renderer::SceneRendererSoftware::RasterKernel::HalfSpace;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderColoredTriangleSceneWithHalfSpaceKernel)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(TriangleDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.rasterKernel = Renderer::SceneRendererSoftware::RasterKernel::HalfSpace;
+
+            RenderAndCompareToReference(renderer, scene, "triangle_software");
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderSimpleSceneWithoutGuardBand)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.useGuardBand = false;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
+        TEST_METHOD(RenderShouldCoverScreenEdgesByTrianglesOutsideOfGuardBand)
+        {
+            // Floor, that the camera looks down at, covers the whole screen and its vertices are far outside of the guard band.
+            Renderer::Scene scene;
+            scene.name = "floor";
+            Renderer::Model& model = scene.models.emplace_back();
+            for (float x : { -1000.0f, 1000.0f })
+            {
+                for (float z : { -1000.0f, 1000.0f })
+                {
+                    Renderer::Vertex& vertex = model.vertices.emplace_back();
+                    vertex.position = { x, 0.0f, z, 1.0f };
+                    vertex.normal = { 0.0f, 1.0f, 0.0f, 0.0f };
+                    vertex.color = Renderer::Color::White;
+                }
+            }
+            model.indices = { 0, 1, 2, 2, 1, 3 };
+            model.backfaceCulling = false;
+            Renderer::SetupClusters(model);
+
+            Renderer::Light& light = scene.lights.emplace_back();
+            light.position = { 0.0f, 5.0f, 0.0f, 1.0f };
+
+            scene.camera.position = { 0.0f, 1.0f, 0.0f, 1.0f };
+            scene.camera.pitch = 1.4f;
+
+            for (Renderer::SceneRendererSoftware::RasterKernel kernel : { Renderer::SceneRendererSoftware::RasterKernel::Scanline, Renderer::SceneRendererSoftware::RasterKernel::HalfSpace })
+            {
+                Renderer::SceneRendererSoftware renderer;
+                renderer.settings.rasterKernel = kernel;
+                Renderer::Texture texture(200, 150);
+                Assert::IsTrue(renderer.Render(scene, texture));
+
+                // Right column and top row are the ones, that clipping by the screen planes left uncovered.
+                const uint32_t* pixels = reinterpret_cast<const uint32_t*>(texture.GetBuffer());
+                for (size_t y = 0; y < texture.GetHeight(); y++)
+                {
+                    Assert::AreNotEqual(0xFF000000u, pixels[y * texture.GetWidth() + texture.GetWidth() - 1]);
+                }
+
+                for (size_t x = 0; x < texture.GetWidth(); x++)
+                {
+                    Assert::AreNotEqual(0xFF000000u, pixels[x]);
+                }
+            }
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderSimpleSceneWithVisibilityBuffer)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.useVisibilityBuffer = true;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderColoredTriangleSceneWithVisibilityBuffer)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(TriangleDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.useVisibilityBuffer = true;
+
+            RenderAndCompareToReference(renderer, scene, "triangle_software");
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderSimpleSceneWithPackedGBufferLayouts)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            // Quantized attributes might change a few pixels, which the comparison tolerates.
+            for (auto layout : { Renderer::SceneRendererSoftware::GBufferLayout::Packed, Renderer::SceneRendererSoftware::GBufferLayout::PackedDepth })
+            {
+                Renderer::SceneRendererSoftware renderer;
+                renderer.settings.gBufferLayout = layout;
+
+                RenderAndCompareToReference(renderer, scene, "software");
+            }
+        }
+
+        TEST_METHOD(RenderShouldRejectOccludedBlocksWithHierarchicalZ)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+
+            const Renderer::SceneRendererSoftware::Statistics& statistics = renderer.GetStatistics();
+            Assert::IsTrue(statistics.hiZRejectedBlocks > 0);
+            Assert::IsTrue(statistics.hiZRejectedBlocks < statistics.hiZTestedBlocks);
+        }
+
+        TEST_METHOD(RenderShouldCullModelsOutsideOfFrustum)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+            Assert::IsTrue(renderer.GetStatistics().culledTriangles > 0);
+
+            // cars are behind the camera, the floor goes around it
+            scene.camera.yaw = 3.14159f;
+
+            Renderer::Texture texture(200, 150);
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::AreEqual(static_cast<uint64_t>(scene.models[0].indices.size() / 3), renderer.GetStatistics().culledTriangles);
+        }
+
+        TEST_METHOD(RenderShouldCullClustersFacingAway)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+            Assert::IsTrue(renderer.GetStatistics().coneCulledTriangles > 0);
+
+            renderer.settings.useConeCulling = false;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+            Assert::AreEqual(uint64_t(0), renderer.GetStatistics().coneCulledTriangles);
+        }
+
+        TEST_METHOD(RenderShouldCullClustersOccludedInPreviousFrameWithoutPopping)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            scene.camera.position = { 0.0f, 0.5f, 6.0f, 1.0f };
+            scene.camera.pitch = 0.0f;
+
+            for (int32_t i = 0; i < 10; i++)
+            {
+                scene.instances.push_back({ 0, Renderer::translate(0.0f, 0.0f, -5.0f * i) });
+            }
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::SceneRendererSoftware referenceRenderer;
+            referenceRenderer.settings.useOcclusionCulling = false;
+
+            Renderer::Texture texture(200, 150);
+            Renderer::Texture reference(200, 150);
+            Renderer::Texture diff(200, 150);
+
+            // The first frame has no previous depth to test against, the next ones cull the cars behind the first one.
+            // Moving the camera further reveals some of them, which have to be drawn in the same frame.
+            for (float x : { 0.0f, 0.1f, 3.0f })
+            {
+                scene.camera.position.x = x;
+
+                Assert::IsTrue(renderer.Render(scene, texture));
+                Assert::IsTrue(referenceRenderer.Render(scene, reference));
+
+                uint32_t differentPixelsCount = 0;
+                Assert::IsTrue(Renderer::Diff(texture, reference, diff, differentPixelsCount));
+                Assert::AreEqual(uint32_t(0), differentPixelsCount);
+            }
+
+            Assert::IsTrue(renderer.GetStatistics().occludedTriangles > 0);
+            Assert::AreEqual(uint64_t(0), referenceRenderer.GetStatistics().occludedTriangles);
+        }
+
+        TEST_METHOD(RenderShouldShadeTilesOnlyByLightsReachingThem)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            scene.camera.position = { 0.0f, 2.3f, 5.0f, 1.0f };
+            scene.camera.pitch = 0.7f;
+
+            for (int32_t i = 0; i < 10; i++)
+            {
+                for (int32_t j = 0; j < 10; j++)
+                {
+                    Renderer::Light light;
+                    light.position = { -3.0f + 0.6f * i, 0.0f, -2.0f + 0.4f * j, 1.0f };
+                    light.color = Renderer::Color(static_cast<uint8_t>(25 * i), 128, static_cast<uint8_t>(25 * j));
+                    light.radius = 0.6f;
+                    scene.lights.push_back(light);
+                }
+            }
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+            Assert::IsTrue(renderer.Render(scene, texture));
+            uint64_t tileLights = renderer.GetStatistics().tileLights;
+
+            Renderer::SceneRendererSoftware referenceRenderer;
+            referenceRenderer.settings.useLightCulling = false;
+            Renderer::Texture reference(200, 150);
+            Assert::IsTrue(referenceRenderer.Render(scene, reference));
+
+            Assert::IsTrue(texture == reference);
+            Assert::IsTrue(tileLights < referenceRenderer.GetStatistics().tileLights);
+        }
+
+        TEST_METHOD(RenderShouldShadeWithSimdKernelLikeScalarKernel)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            for (int32_t i = 0; i < 10; i++)
+            {
+                Renderer::Light light;
+                light.position = { -3.0f + 0.6f * i, 0.5f, 0.0f, 1.0f };
+                light.color = Renderer::Color(static_cast<uint8_t>(25 * i), 128, 255);
+                light.radius = 1.5f;
+                light.specularStrength = 0.5f;
+                light.specularShininess = 16.0f;
+                scene.lights.push_back(light);
+            }
+
+            // Only specular highlights might differ, as SIMD kernel approximates pow.
+            for (bool useVisibilityBuffer : { false, true })
+            {
+                Renderer::SceneRendererSoftware renderer;
+                renderer.settings.useVisibilityBuffer = useVisibilityBuffer;
+                Renderer::Texture texture(200, 150);
+                Assert::IsTrue(renderer.Render(scene, texture));
+
+                Renderer::SceneRendererSoftware referenceRenderer;
+                referenceRenderer.settings.useVisibilityBuffer = useVisibilityBuffer;
+                referenceRenderer.settings.shadingKernel = Renderer::SceneRendererSoftware::ShadingKernel::Scalar;
+                Renderer::Texture reference(200, 150);
+                Assert::IsTrue(referenceRenderer.Render(scene, reference));
+
+                Renderer::Texture diff(200, 150);
+                uint32_t differentPixelsCount = 0;
+                Assert::IsTrue(Renderer::Diff(texture, reference, diff, differentPixelsCount));
+                Assert::IsTrue(differentPixelsCount < 200 * 150 / 1000);
+            }
+        }
+
+        TEST_METHOD(RenderShouldProperlyRenderSimpleSceneWithSinglePass)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            renderer.settings.useSinglePass = true;
+
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
+        TEST_METHOD(RenderShouldOverdrawLessInSinglePass)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Renderer::SceneRendererSoftware::Statistics twoPass = renderer.GetStatistics();
+
+            renderer.settings.useSinglePass = true;
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Renderer::SceneRendererSoftware::Statistics singlePass = renderer.GetStatistics();
+
+            Assert::IsTrue(twoPass.coveredPixels > 0);
+            Assert::IsTrue(singlePass.coveredPixels == twoPass.coveredPixels);
+            Assert::IsTrue(singlePass.depthWrittenPixels >= singlePass.coveredPixels);
+            Assert::IsTrue(singlePass.depthWrittenPixels < twoPass.depthWrittenPixels);
+        }
+
+        TEST_METHOD(RenderShouldNotGrowBuffersWhenSceneDoesNotChange)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().buffersGrowthBytes > 0);
+
+            // Unchanged frames are not rendered, so a setting is switched and back to render the same scene from scratch again.
+            renderer.settings.useLightCulling = false;
+            Assert::IsTrue(renderer.Render(scene, texture));
+            renderer.settings.useLightCulling = true;
+            Assert::IsTrue(renderer.Render(scene, texture));
+
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Full);
+            Assert::IsTrue(renderer.GetStatistics().buffersGrowthBytes == 0);
+        }
+
+        TEST_METHOD(RenderShouldRunOnlyStagesAffectedBySceneChanges)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Full);
+            Renderer::Texture frame = texture;
+
+            // Texture is not written, it still holds the previous frame.
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::None);
+            Assert::IsTrue(texture == frame);
+
+            // Another texture gets the same frame shaded from the buffers of the previous one.
+            RenderAndCompareToReference(renderer, scene, "software");
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Shading);
+
+            // Light changes are shaded on the buffers of the previous frame, which have to match a frame rendered from scratch.
+            scene.lights[0].color = Renderer::Color(255, 128, 64);
+            Renderer::SceneRendererSoftware referenceRenderer;
+            Renderer::Texture reference(200, 150);
+            Assert::IsTrue(referenceRenderer.Render(scene, reference));
+
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Shading);
+            Assert::IsTrue(texture == reference);
+
+            scene.models[0].position.x += 1.0f;
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Full);
+
+            // Geometry edited in place is told by the version.
+            scene.models[0].vertices[0].position.y += 0.1f;
+            scene.models[0].version++;
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Full);
+
+            renderer.settings.useVisibilityBuffer = true;
+            Assert::IsTrue(renderer.Render(scene, texture));
+            Assert::IsTrue(renderer.GetStatistics().frameUpdate == Renderer::SceneRendererSoftware::FrameUpdate::Full);
+        }
+
+        TEST_METHOD(RenderShouldScaleResolutionToHoldTargetFrameTime)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+
+            // Scale follows the timings of the previous frames, so the camera moves to render every frame from scratch.
+            float yaw = scene.camera.yaw;
+            auto renderFrames = [&]() {
+                for (int32_t i = 0; i < 10; i++)
+                {
+                    scene.camera.yaw = yaw + (i % 2) * 0.01f;
+                    Assert::IsTrue(renderer.Render(scene, texture));
+                }
+            };
+
+            renderer.settings.targetFrameTime = 0.001f;
+            renderFrames();
+            Assert::AreEqual(renderer.settings.minResolutionScale, renderer.GetStatistics().resolutionScale);
+            Assert::AreEqual(size_t(200), texture.GetWidth());
+            Assert::AreEqual(size_t(150), texture.GetHeight());
+
+            // Full resolution fits the budget again, so the frame is rendered without scaling.
+            renderer.settings.targetFrameTime = 1000.0f;
+            renderFrames();
+            scene.camera.yaw = yaw;
+            RenderAndCompareToReference(renderer, scene, "software");
+            Assert::AreEqual(1.0f, renderer.GetStatistics().resolutionScale);
+        }
+
+        TEST_METHOD(RenderShouldNotKeepPreviousFrameInUncoveredTiles)
+        {
+            Renderer::Scene scene;
+            Assert::IsTrue(Renderer::Load(CarsDir + "scene.sce", scene));
+
+            Renderer::SceneRendererSoftware renderer;
+            Renderer::Texture texture(200, 150);
+
+            // Looking down, the floor covers tiles, that are empty in the next frame, so their buffers are left with its depth and attributes.
+            float pitch = scene.camera.pitch;
+            scene.camera.pitch = 6.0f;
+            Assert::IsTrue(renderer.Render(scene, texture));
+
+            scene.camera.pitch = pitch;
+            RenderAndCompareToReference(renderer, scene, "software");
+        }
+
         TEST_METHOD(RenderShouldReturnFalseIfTextureHasZeroDimension)
         {
             Renderer::Scene scene;